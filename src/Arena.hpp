@@ -0,0 +1,111 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump-pointer allocator for objects that all die together, such as the AST
+ * nodes of one parse.
+ *
+ * Objects are packed into large blocks in allocation order, so a tree built
+ * depth-first ends up laid out roughly the way it is walked. Nothing is freed
+ * individually: the destructor runs the objects' destructors (newest first)
+ * and then releases the blocks. rewind() does the same for just the objects
+ * created since a mark().
+ */
+class Arena {
+public:
+  Arena() = default;
+  ~Arena() { release(); }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      m_destructors.push_back(
+          {object, [](void *p) { static_cast<T *>(p)->~T(); }});
+    }
+    return object;
+  }
+
+  // Destroys every object and frees all blocks; the arena can be reused.
+  void release() {
+    for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it) {
+      it->destroy(it->object);
+    }
+    m_destructors.clear();
+    m_blocks.clear();
+    m_next = m_end = nullptr;
+  }
+
+  // A point in the allocation sequence that rewind() can return to
+  struct Mark {
+    size_t blocks;
+    size_t destructors;
+    std::byte *next;
+    std::byte *end;
+  };
+
+  Mark mark() const {
+    return {m_blocks.size(), m_destructors.size(), m_next, m_end};
+  }
+
+  // Destroys every object created since `mark` and frees the blocks taken
+  // since, so that the arena continues from where it was at `mark`.
+  void rewind(const Mark &mark) {
+    while (m_destructors.size() > mark.destructors) {
+      m_destructors.back().destroy(m_destructors.back().object);
+      m_destructors.pop_back();
+    }
+    while (m_blocks.size() > mark.blocks) {
+      m_blocks.pop_back();
+    }
+    m_next = mark.next;
+    m_end = mark.end;
+  }
+
+private:
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  static constexpr size_t kBlockSize = 64 * 1024;
+
+  void *allocate(size_t size, size_t alignment) {
+    std::byte *start = alignUp(m_next, alignment);
+    if (start == nullptr || start + size > m_end) {
+      size_t blockSize = std::max(kBlockSize, size + alignment);
+      m_blocks.push_back(std::make_unique<std::byte[]>(blockSize));
+      m_next = m_blocks.back().get();
+      m_end = m_next + blockSize;
+      start = alignUp(m_next, alignment);
+    }
+    m_next = start + size;
+    return start;
+  }
+
+  static std::byte *alignUp(std::byte *p, size_t alignment) {
+    auto address = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<std::byte *>((address + alignment - 1) &
+                                         ~(alignment - 1));
+  }
+
+  std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+  std::vector<Destructor> m_destructors;
+  std::byte *m_next = nullptr;
+  std::byte *m_end = nullptr;
+};
+
+#endif // ARENA_H_
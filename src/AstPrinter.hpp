@@ -1,7 +1,6 @@
 #pragma once
 #include "Expr.hpp"
-#include "LoxCallable.h"
-#include "LoxInstance.h"
+#include "Value.h"
 #include <initializer_list>
 #include <memory>
 #include <sstream>
@@ -11,11 +10,11 @@ public:
   std::string print(const Expr &expr) { return expr.accept(*this); }
 
   std::string visitBinaryExpr(const BinaryExpr &expr) override {
-    return parenthesize(expr.op.lexeme, {&expr.left, &expr.right});
+    return parenthesize(std::string(expr.op.lexeme), {&expr.left, &expr.right});
   }
 
   std::string visitLogicalExpr(const LogicalExpr &expr) override {
-    return parenthesize(expr.op.lexeme, {&expr.left, &expr.right});
+    return parenthesize(std::string(expr.op.lexeme), {&expr.left, &expr.right});
   }
 
   std::string visitGroupingExpr(const GroupingExpr &expr) override {
@@ -23,19 +22,19 @@ public:
   }
 
   std::string visitLiteralExpr(const LiteralExpr &expr) override {
-    return std::visit(LiteralPrinter{}, expr.value);
+    return valueToString(expr.value);
   }
 
   std::string visitUnaryExpr(const UnaryExpr &expr) override {
-    return parenthesize(expr.op.lexeme, {&expr.right});
+    return parenthesize(std::string(expr.op.lexeme), {&expr.right});
   }
 
   std::string visitVariableExpr(const VariableExpr &expr) override {
-    return expr.name.lexeme; // Just print the variable name
+    return std::string(expr.name.lexeme); // Just print the variable name
   }
 
   std::string visitAssignExpr(const AssignExpr &expr) override {
-    return parenthesize("assign " + expr.name.lexeme, {&expr.value});
+    return parenthesize("assign " + std::string(expr.name.lexeme), {&expr.value});
   }
 
   std::string visitCallExpr(const CallExpr &expr) override {
@@ -43,45 +42,20 @@ public:
   }
 
   std::string visitGetExpr(const GetExpr &expr) override {
-    return parenthesize("get " + expr.name.lexeme, {&expr.object});
+    return parenthesize("get " + std::string(expr.name.lexeme), {&expr.object});
   }
 
   std::string visitSetExpr(const SetExpr &expr) override {
-    return parenthesize("set " + expr.name.lexeme, {&expr.object, &expr.value});
+    return parenthesize("set " + std::string(expr.name.lexeme), {&expr.object, &expr.value});
   }
 
   std::string visitThisExpr(const ThisExpr &expr) override { return "this"; }
 
   std::string visitSuperExpr(const SuperExpr &expr) override {
-    return "super." + expr.method.lexeme;
+    return "super." + std::string(expr.method.lexeme);
   }
 
 private:
-  // Helper struct to print different literal types
-  struct LiteralPrinter {
-    std::string operator()(const std::string &s) const {
-      return "\"" + s + "\"";
-    }
-    std::string operator()(bool b) const { return b ? "true" : "false"; }
-    std::string operator()(int d) const { return std::to_string(d); }
-    std::string operator()(double d) const {
-      std::string s = std::to_string(d);
-      // trim trailing zeros
-      s.erase(s.find_last_not_of('0') + 1);
-      if (s.back() == '.') {
-        s.erase(s.size() - 1);
-      }
-      return s;
-    }
-    std::string operator()(std::nullptr_t) const { return "nil"; }
-    std::string operator()(const std::shared_ptr<LoxCallable> &callable) const {
-      return callable->toString();
-    }
-    std::string operator()(const std::shared_ptr<LoxInstance> &instance) const {
-      return instance->toString();
-    }
-  };
-
   template <typename Container>
   std::string parenthesize(const std::string &name, const Container &exprs) {
     std::stringstream builder;
@@ -0,0 +1,12 @@
+#include "Chunk.h"
+#include <algorithm>
+
+const Token &Chunk::siteBefore(size_t offset) const {
+  // Sites are recorded in emission order, so they are sorted by offset.
+  auto it = std::lower_bound(
+      m_sites.begin(), m_sites.end(), offset,
+      [](const std::pair<size_t, Token> &site, size_t target) {
+        return site.first < target;
+      });
+  return std::prev(it)->second;
+}
@@ -0,0 +1,117 @@
+#ifndef CHUNK_H_
+#define CHUNK_H_
+#pragma once
+
+#include "Token.h"
+#include "Value.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Operands are big-endian. An index that doesn't fit its instruction's u8 or
+// u16 operand uses the _LONG form, whose operand is a u24; jump offsets and
+// the constants of rarer instructions are always u24.
+enum class OpCode : uint8_t {
+  CONSTANT,           // u16 constant index
+  CONSTANT_LONG,      // u24 constant index
+  NIL,
+  TRUE,
+  FALSE,
+  POP,
+  GET_LOCAL,          // u8 slot
+  GET_LOCAL_LONG,     // u24 slot
+  SET_LOCAL,          // u8 slot
+  SET_LOCAL_LONG,     // u24 slot
+  GET_GLOBAL,         // u16 global index
+  GET_GLOBAL_LONG,    // u24 global index
+  DEFINE_GLOBAL,      // u16 global index
+  DEFINE_GLOBAL_LONG, // u24 global index
+  SET_GLOBAL,         // u16 global index
+  SET_GLOBAL_LONG,    // u24 global index
+  GET_UPVALUE,        // u8 upvalue index
+  GET_UPVALUE_LONG,   // u24 upvalue index
+  SET_UPVALUE,        // u8 upvalue index
+  SET_UPVALUE_LONG,   // u24 upvalue index
+  GET_PROPERTY,       // u24 name constant
+  SET_PROPERTY,       // u24 name constant
+  GET_SUPER,          // u24 name constant
+  EQUAL,
+  NOT_EQUAL,
+  GREATER,
+  GREATER_EQUAL,
+  LESS,
+  LESS_EQUAL,
+  ADD,
+  SUBTRACT,
+  MULTIPLY,
+  DIVIDE,
+  NOT,
+  NEGATE,
+  PRINT,
+  JUMP,          // u24 forward offset
+  JUMP_IF_FALSE, // u24 forward offset, leaves the condition on the stack
+  LOOP,          // u24 backward offset
+  CALL,          // u8 argument count
+  INVOKE,        // u24 name constant, u8 argument count
+  CLOSURE,       // u24 function constant, then (u8 isLocal, u24 index) per
+                 // upvalue
+  CLOSE_UPVALUE,
+  RETURN,
+  CLASS,         // u24 name constant
+  INHERIT,
+  METHOD,        // u24 name constant
+};
+
+// Largest operand of a _LONG instruction, and so the most constants,
+// globals, locals or upvalues a chunk can use
+inline constexpr size_t kLongOperandMax = (1 << 24) - 1;
+
+/**
+ * A sequence of bytecode together with its constant pool.
+ *
+ * Instead of a line per byte, the chunk remembers the source token of every
+ * instruction that can raise a runtime error, so the VM reports errors exactly
+ * like the tree-walker ("[line N] Error at 'tok': ...").
+ */
+class Chunk {
+public:
+  void write(uint8_t byte) { code.push_back(byte); }
+
+  void write(OpCode op) { write(static_cast<uint8_t>(op)); }
+
+  // Writes an instruction that may fail at runtime, recording its token.
+  void write(OpCode op, const Token &site) {
+    m_sites.emplace_back(code.size(), site);
+    write(op);
+  }
+
+  // Writes an operand byte; failures after it has been read are reported at
+  // `site` rather than at its instruction's token.
+  void write(uint8_t byte, const Token &site) {
+    m_sites.emplace_back(code.size(), site);
+    write(byte);
+  }
+
+  size_t addConstant(Value value) {
+    constants.push_back(value);
+    return constants.size() - 1;
+  }
+
+  // Returns the token of the instruction executing when the instruction
+  // pointer has advanced to `offset` (i.e. the last recorded site before it).
+  const Token &siteBefore(size_t offset) const;
+
+  // Bytes of code, constants and error sites
+  size_t bytes() const {
+    return code.capacity() + constants.capacity() * sizeof(Value) +
+           m_sites.capacity() * sizeof(m_sites[0]);
+  }
+
+  std::vector<uint8_t> code;
+  std::vector<Value> constants;
+
+private:
+  std::vector<std::pair<size_t, Token>> m_sites;
+};
+
+#endif // CHUNK_H_
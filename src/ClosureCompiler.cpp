@@ -0,0 +1,589 @@
+#include "ClosureCompiler.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "error.h"
+#include <iostream>
+
+// Evaluates the right operand of a binary expression. The left one must stay
+// rooted meanwhile, since the right one may run Lox code that collects.
+static Value evaluateRight(Interpreter &interpreter, Value left,
+                           const ExprCode &right) {
+  if (!left.isObj()) {
+    return right();
+  }
+  Interpreter::Roots roots(interpreter);
+  roots.push(left);
+  return right();
+}
+
+void ClosureCompiler::interpret(const std::vector<Stmt *> &statements) {
+  CompiledBlock program = compileBlock(statements);
+  try {
+    run(m_interpreter, program);
+  } catch (const RuntimeError &error) {
+    lox::error(error.m_token, error.what(), true);
+  }
+}
+
+Completion ClosureCompiler::executeBlock(Interpreter &interpreter,
+                                         const CompiledBlock &block,
+                                         Environment *env) {
+  Interpreter::Roots roots(interpreter);
+  Environment *previous = interpreter.m_envptr;
+  roots.push(previous);
+  interpreter.m_envptr = env;
+
+  Completion completion;
+  try {
+    completion = run(interpreter, block);
+  } catch (...) {
+    interpreter.m_envptr = previous;
+    throw;
+  }
+
+  interpreter.m_envptr = previous;
+  return completion;
+}
+
+Completion ClosureCompiler::run(Interpreter &interpreter,
+                                const CompiledBlock &block) {
+  for (const StmtCode &statement : block.statements) {
+    // Statement boundaries are the collector's safe points, as in
+    // Interpreter::execute
+    if (interpreter.m_heap.wantsCollection()) {
+      interpreter.m_heap.collectGarbage();
+    }
+    Completion completion = statement();
+    if (completion != Completion::NORMAL) {
+      return completion;
+    }
+  }
+  return Completion::NORMAL;
+}
+
+ExprCode ClosureCompiler::compile(const Expr &expr) {
+  expr.accept(*this);
+  return std::move(m_expr);
+}
+
+StmtCode ClosureCompiler::compile(const Stmt &stmt) {
+  stmt.accept(*this);
+  return std::move(m_stmt);
+}
+
+CompiledBlock
+ClosureCompiler::compileBlock(const std::vector<Stmt *> &statements) {
+  CompiledBlock block;
+  for (const Stmt *statement : statements) {
+    block.statements.push_back(compile(*statement));
+  }
+  return block;
+}
+
+const CompiledBlock *
+ClosureCompiler::compileFunction(const FunctionStmt &function) {
+  return &m_functions.emplace_back(compileBlock(function.body));
+}
+
+// Expressions
+
+void ClosureCompiler::visitLiteralExpr(const LiteralExpr &expr) {
+  Value value = expr.value;
+  m_expr = [value] { return value; };
+}
+
+void ClosureCompiler::visitGroupingExpr(const GroupingExpr &expr) {
+  m_expr = compile(expr.expr);
+}
+
+void ClosureCompiler::visitUnaryExpr(const UnaryExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  ExprCode right = compile(expr.right);
+  switch (expr.opcode) {
+  case UnaryOp::NEGATE:
+    m_expr = [in, right = std::move(right), &op = expr.op]() -> Value {
+      Value operand = right();
+      in->checkNumberOperand(op, operand);
+      return -operand.asNumber();
+    };
+    break;
+  case UnaryOp::NOT:
+    m_expr = [right = std::move(right)]() -> Value {
+      return right().isFalsey();
+    };
+    break;
+  }
+}
+
+template <typename Operation>
+ExprCode ClosureCompiler::numeric(const BinaryExpr &expr,
+                                  Operation operation) {
+  Interpreter *in = &m_interpreter;
+  ExprCode left = compile(expr.left);
+  ExprCode right = compile(expr.right);
+  return [in, left = std::move(left), right = std::move(right), &op = expr.op,
+          operation]() -> Value {
+    Value a = left();
+    Value b = evaluateRight(*in, a, right);
+    in->checkNumberOperand(op, a, b);
+    return operation(a.asNumber(), b.asNumber());
+  };
+}
+
+void ClosureCompiler::visitBinaryExpr(const BinaryExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  switch (expr.opcode) {
+  case BinaryOp::ADD: {
+    ExprCode left = compile(expr.left);
+    ExprCode right = compile(expr.right);
+    m_expr = [in, left = std::move(left), right = std::move(right),
+              &op = expr.op]() -> Value {
+      Value a = left();
+      Value b = evaluateRight(*in, a, right);
+      if (a.isNumber() && b.isNumber()) {
+        return a.asNumber() + b.asNumber();
+      }
+      if (isObjType(a, ObjType::STRING) && isObjType(b, ObjType::STRING)) {
+        return in->heap().intern(static_cast<ObjString *>(a.asObj())->chars +
+                                 static_cast<ObjString *>(b.asObj())->chars);
+      }
+      throw RuntimeError(op, "Operands must be two numbers or two strings.");
+    };
+    break;
+  }
+  case BinaryOp::SUBTRACT:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a - b; });
+    break;
+  case BinaryOp::MULTIPLY:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a * b; });
+    break;
+  case BinaryOp::DIVIDE: {
+    const Token &op = expr.op;
+    m_expr = numeric(expr, [&op](double a, double b) -> Value {
+      if (b == 0) {
+        throw RuntimeError(op, "Division by zero.");
+      }
+      return a / b;
+    });
+    break;
+  }
+  case BinaryOp::GREATER:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a > b; });
+    break;
+  case BinaryOp::GREATER_EQUAL:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a >= b; });
+    break;
+  case BinaryOp::LESS:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a < b; });
+    break;
+  case BinaryOp::LESS_EQUAL:
+    m_expr = numeric(expr, [](double a, double b) -> Value { return a <= b; });
+    break;
+  case BinaryOp::EQUAL:
+  case BinaryOp::NOT_EQUAL: {
+    ExprCode left = compile(expr.left);
+    ExprCode right = compile(expr.right);
+    bool negate = expr.opcode == BinaryOp::NOT_EQUAL;
+    m_expr = [in, left = std::move(left), right = std::move(right),
+              negate]() -> Value {
+      Value a = left();
+      Value b = evaluateRight(*in, a, right);
+      return valuesEqual(a, b) != negate;
+    };
+    break;
+  }
+  }
+}
+
+void ClosureCompiler::visitLogicalExpr(const LogicalExpr &expr) {
+  ExprCode left = compile(expr.left);
+  ExprCode right = compile(expr.right);
+  if (expr.opcode == LogicalOp::OR) {
+    m_expr = [left = std::move(left), right = std::move(right)] {
+      Value value = left();
+      return value.isFalsey() ? right() : value;
+    };
+  } else {
+    m_expr = [left = std::move(left), right = std::move(right)] {
+      Value value = left();
+      return value.isFalsey() ? value : right();
+    };
+  }
+}
+
+ExprCode ClosureCompiler::variable(const Token &name, LocalSlot local) {
+  Interpreter *in = &m_interpreter;
+  switch (local.storage) {
+  case LocalSlot::Storage::FRAME:
+    return [in, slot = local.slot] { return in->m_frame[slot]; };
+  case LocalSlot::Storage::ENVIRONMENT:
+    return [in, local] { return in->m_envptr->getAt(local); };
+  case LocalSlot::Storage::GLOBAL:
+    break;
+  }
+  return [in, &name, index = static_cast<uint32_t>(local.slot)] {
+    return in->m_globals->getGlobal(name, index);
+  };
+}
+
+void ClosureCompiler::visitVariableExpr(const VariableExpr &expr) {
+  m_expr = variable(expr.name, expr.local);
+}
+
+void ClosureCompiler::visitThisExpr(const ThisExpr &expr) {
+  m_expr = variable(expr.keyword, expr.local);
+}
+
+void ClosureCompiler::visitAssignExpr(const AssignExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  ExprCode value = compile(expr.value);
+  LocalSlot local = expr.local;
+  switch (local.storage) {
+  case LocalSlot::Storage::FRAME:
+    m_expr = [in, value = std::move(value), slot = local.slot] {
+      return in->m_frame[slot] = value();
+    };
+    return;
+  case LocalSlot::Storage::ENVIRONMENT:
+    m_expr = [in, value = std::move(value), local] {
+      Value result = value();
+      in->m_envptr->assignAt(local, result);
+      return result;
+    };
+    return;
+  case LocalSlot::Storage::GLOBAL:
+    break;
+  }
+  m_expr = [in, value = std::move(value), &name = expr.name,
+            index = static_cast<uint32_t>(local.slot)] {
+    Value result = value();
+    in->m_globals->assignGlobal(name, index, result);
+    return result;
+  };
+}
+
+std::span<const Value> ClosureCompiler::evaluateArguments(
+    Interpreter &interpreter, const CallExpr &expr,
+    const std::vector<ExprCode> &arguments, Interpreter::Roots &roots) {
+  std::vector<Value> &stack = interpreter.m_stack;
+  if (stack.size() + arguments.size() > Interpreter::kStackMax) {
+    throw RuntimeError(expr.paren, "Stack overflow.");
+  }
+  size_t base = stack.size();
+  for (const ExprCode &argument : arguments) {
+    roots.push(argument());
+  }
+  return {stack.data() + base, arguments.size()};
+}
+
+Value ClosureCompiler::call(Interpreter &interpreter, const CallExpr &expr,
+                            const std::vector<ExprCode> &arguments,
+                            Value callee, Interpreter::Roots &roots) {
+  std::span<const Value> values =
+      evaluateArguments(interpreter, expr, arguments, roots);
+
+  if (!isCallable(callee)) {
+    throw RuntimeError(expr.paren, "Can only call functions and classes.");
+  }
+
+  LoxCallable *function = asCallable(callee);
+  interpreter.checkArity(expr, function->arity(), values.size());
+  Interpreter::CallDepth depth(interpreter, expr);
+  return function->call(interpreter, values);
+}
+
+void ClosureCompiler::visitCallExpr(const CallExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  std::vector<ExprCode> arguments;
+  for (const Expr *argument : expr.arguments) {
+    arguments.push_back(compile(*argument));
+  }
+
+  // Methods are invoked on their receiver without a bound method, as in
+  // Interpreter::visitCallExpr.
+  if (auto *get = dynamic_cast<const GetExpr *>(&expr.callee)) {
+    ExprCode object = compile(get->object);
+    m_expr = [in, object = std::move(object), arguments = std::move(arguments),
+              get, &expr]() -> Value {
+      Interpreter::Roots roots(*in);
+      Value receiver = roots.push(object());
+      if (!isInstance(receiver)) {
+        throw RuntimeError(get->name, "Only instances have properties.");
+      }
+      Value field;
+      LoxFunction *method = asInstance(receiver)->getMethodOrField(
+          get->name, get->cache, field);
+      if (method) {
+        std::span<const Value> values =
+            evaluateArguments(*in, expr, arguments, roots);
+        in->checkArity(expr, method->arity(), values.size());
+        Interpreter::CallDepth depth(*in, expr);
+        return method->invoke(*in, asInstance(receiver), values);
+      }
+      return call(*in, expr, arguments, roots.push(field), roots);
+    };
+    return;
+  }
+
+  ExprCode callee = compile(expr.callee);
+  m_expr = [in, callee = std::move(callee), arguments = std::move(arguments),
+            &expr] {
+    // The callee stays rooted for the whole call
+    Interpreter::Roots roots(*in);
+    Value function = roots.push(callee());
+    return call(*in, expr, arguments, function, roots);
+  };
+}
+
+void ClosureCompiler::visitGetExpr(const GetExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  ExprCode object = compile(expr.object);
+  m_expr = [in, object = std::move(object), &expr] {
+    Value value = object();
+    if (!isInstance(value)) {
+      throw RuntimeError(expr.name, "Only instances have properties.");
+    }
+    return asInstance(value)->get(in->heap(), expr.name, expr.cache);
+  };
+}
+
+void ClosureCompiler::visitSetExpr(const SetExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  ExprCode object = compile(expr.object);
+  ExprCode value = compile(expr.value);
+  m_expr = [in, object = std::move(object), value = std::move(value), &expr] {
+    Interpreter::Roots roots(*in);
+    Value instance = roots.push(object());
+    if (!isInstance(instance)) {
+      throw RuntimeError(expr.name, "Only instances have fields.");
+    }
+    Value result = value();
+    asInstance(instance)->set(in->heap(), expr.name.symbol, result,
+                              expr.cache);
+    return result;
+  };
+}
+
+void ClosureCompiler::visitSuperExpr(const SuperExpr &expr) {
+  Interpreter *in = &m_interpreter;
+  if (expr.local.isGlobal()) {
+    m_expr = [&expr]() -> Value {
+      throw RuntimeError(expr.keyword, "Undefined 'super' binding.");
+    };
+    return;
+  }
+
+  // `super` lives in its own scope just outside the method's scope
+  LocalSlot super = expr.local;
+  ExprCode self = variable(expr.keyword, expr.receiver);
+  m_expr = [in, super, self = std::move(self), &expr]() -> Value {
+    auto *superclass =
+        dynamic_cast<LoxClass *>(in->m_envptr->getAt(super).asObj());
+    if (!superclass) {
+      throw RuntimeError(expr.keyword, "Superclass must be a class.");
+    }
+    LoxInstance *object = asInstance(self());
+    LoxFunction *method = superclass->findMethod(expr.method.symbol);
+    if (!method) {
+      throw RuntimeError(expr.method,
+                         "Undefined property '" +
+                             std::string(expr.method.lexeme) + "'.");
+    }
+    return method->bind(in->heap(), object);
+  };
+}
+
+// Statements
+
+void ClosureCompiler::visitExpressionStmt(const ExpressionStmt &stmt) {
+  ExprCode expression = compile(stmt.expression);
+  m_stmt = [expression = std::move(expression)] {
+    expression();
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitPrintStmt(const PrintStmt &stmt) {
+  ExprCode expression = compile(stmt.expression);
+  m_stmt = [expression = std::move(expression)] {
+    std::cout << valueToString(expression()) << std::endl;
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitVarStmt(const VarStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  ExprCode initializer;
+  if (stmt.initializer) {
+    initializer = compile(*stmt.initializer);
+  }
+  m_stmt = [in, initializer = std::move(initializer), local = stmt.local] {
+    Value value = initializer ? initializer() : Value(nullptr);
+    in->declare(local, value);
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitBlockStmt(const BlockStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  const ScopeLayout &layout = stmt.layout;
+  CompiledBlock block = compileBlock(stmt.statements);
+  if (!stmt.frame.names.empty()) {
+    // Outermost block of top-level code, whose locals need a frame
+    m_stmt = [in, &stmt, block = std::move(block)] {
+      Interpreter::Frame frame(*in, stmt.frame);
+      if (!stmt.hasScope) {
+        return run(*in, block);
+      }
+      return executeBlock(
+          *in, block, in->heap().allocate<Environment>(in->m_envptr, stmt.layout));
+    };
+  } else if (!stmt.hasScope) {
+    m_stmt = [in, block = std::move(block)] { return run(*in, block); };
+  } else {
+    m_stmt = [in, &layout, block = std::move(block)] {
+      return executeBlock(
+          *in, block, in->heap().allocate<Environment>(in->m_envptr, layout));
+    };
+  }
+}
+
+void ClosureCompiler::visitIfStmt(const IfStmt &stmt) {
+  ExprCode condition = compile(stmt.condition);
+  StmtCode thenBranch = compile(stmt.thenBranch);
+  StmtCode elseBranch;
+  if (stmt.elseBranch) {
+    elseBranch = compile(*stmt.elseBranch);
+  }
+  m_stmt = [condition = std::move(condition), thenBranch = std::move(thenBranch),
+            elseBranch = std::move(elseBranch)] {
+    if (!condition().isFalsey()) {
+      return thenBranch();
+    } else if (elseBranch) {
+      return elseBranch();
+    }
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitWhileStmt(const WhileStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  ExprCode condition = compile(stmt.condition);
+  StmtCode body = compile(stmt.body);
+  StmtCode increment;
+  if (stmt.increment) {
+    increment = compile(*stmt.increment);
+  }
+  m_stmt = [in, condition = std::move(condition), body = std::move(body),
+            increment = std::move(increment)] {
+    while (!condition().isFalsey()) {
+      // A body that isn't a block has no statement boundary of its own
+      if (in->m_heap.wantsCollection()) {
+        in->m_heap.collectGarbage();
+      }
+      Completion completion = body();
+      if (completion == Completion::RETURN) {
+        return completion; // Leave it for the enclosing call
+      }
+      if (completion == Completion::BREAK) {
+        break;
+      }
+      if (increment) {
+        increment();
+      }
+    }
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitBreakStmt(const BreakStmt &stmt) {
+  m_stmt = [] { return Completion::BREAK; };
+}
+
+void ClosureCompiler::visitContinueStmt(const ContinueStmt &stmt) {
+  m_stmt = [] { return Completion::CONTINUE; };
+}
+
+void ClosureCompiler::visitReturnStmt(const ReturnStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  ExprCode value;
+  if (stmt.value) {
+    value = compile(*stmt.value);
+  }
+  m_stmt = [in, value = std::move(value)] {
+    in->m_returnValue = value ? value() : Value(nullptr);
+    return Completion::RETURN;
+  };
+}
+
+void ClosureCompiler::visitFunctionStmt(const FunctionStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  const ScopeLayout &layout = stmt.layout;
+  const CompiledBlock *body = compileFunction(stmt);
+  m_stmt = [in, &stmt, &layout, body] {
+    LoxFunction *function = in->heap().allocate<LoxFunction>(
+        &stmt, in->m_envptr, layout, false, body);
+    in->declare(stmt.local, function);
+    return Completion::NORMAL;
+  };
+}
+
+void ClosureCompiler::visitClassStmt(const ClassStmt &stmt) {
+  Interpreter *in = &m_interpreter;
+  ExprCode superclassCode;
+  if (stmt.superclass) {
+    superclassCode = compile(*stmt.superclass);
+  }
+
+  struct Method {
+    const FunctionStmt *declaration;
+    const ScopeLayout *layout;
+    const CompiledBlock *body;
+    bool isInitializer;
+  };
+  std::vector<Method> methods;
+  for (const FunctionStmt *method : stmt.methods) {
+    methods.push_back(
+        {method, &method->layout, compileFunction(*method),
+         method->name.lexeme == "init"});
+  }
+
+  m_stmt = [in, superclassCode = std::move(superclassCode),
+            methods = std::move(methods), &stmt] {
+    LoxClass *superclass = nullptr;
+    if (superclassCode) {
+      Value superclassValue = superclassCode();
+      if (isCallable(superclassValue)) {
+        superclass = dynamic_cast<LoxClass *>(asCallable(superclassValue));
+      }
+      if (!superclass) {
+        throw RuntimeError(stmt.superclass->name,
+                           "Superclass must be a class.");
+      }
+    }
+
+    Environment *closure = in->m_envptr;
+    if (superclass) {
+      closure = in->heap().allocate<Environment>(closure, kSuperScope);
+      closure->define(superclass);
+    }
+
+    // Inherited methods are copied down, as in Interpreter::visitClassStmt
+    std::unordered_map<Symbol, LoxFunction *> table;
+    if (superclass) {
+      table = superclass->methods();
+    }
+    for (const Method &method : methods) {
+      table[method.declaration->name.symbol] =
+          in->heap().allocate<LoxFunction>(
+              method.declaration, closure, *method.layout,
+              method.isInitializer, method.body);
+    }
+
+    LoxClass *klass = in->heap().allocate<LoxClass>(
+        std::string(stmt.name.lexeme), std::move(table));
+    in->declare(stmt.local, klass);
+    return Completion::NORMAL;
+  };
+}
@@ -0,0 +1,97 @@
+#ifndef CLOSURE_COMPILER_H_
+#define CLOSURE_COMPILER_H_
+#pragma once
+
+#include "Expr.hpp"
+#include "Interpreter.h"
+#include "Stmt.hpp"
+#include <deque>
+#include <functional>
+#include <span>
+#include <vector>
+
+// Compiled code: a callable with everything its node needs (children,
+// decoded operator, resolved slot) already bound in.
+using ExprCode = std::function<Value()>;
+using StmtCode = std::function<Completion()>;
+
+// The compiled statements of a block or function body
+struct CompiledBlock {
+  std::vector<StmtCode> statements;
+};
+
+/**
+ * Execution engine between the tree-walker and the VM: turns the resolved
+ * AST into a tree of pre-linked closures once, then runs those.
+ *
+ * Compilation copies the Resolver's results off the AST into the closures.
+ * Running a program therefore does no visitor double dispatch and no
+ * operator decoding.
+ * The runtime is the Interpreter's (heap, environments, globals, roots), and
+ * functions, classes and instances are the same objects the tree-walker
+ * uses, so both engines behave identically.
+ */
+class ClosureCompiler : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+  explicit ClosureCompiler(Interpreter &interpreter)
+      : m_interpreter(interpreter) {}
+
+  // Compiles and runs a program, reporting runtime errors like
+  // Interpreter::interpret. The compiler must outlive the program's run.
+  void interpret(const std::vector<Stmt *> &statements);
+
+  // Runs a compiled function body in `env`, like Interpreter::executeBlock
+  static Completion executeBlock(Interpreter &interpreter,
+                                 const CompiledBlock &block, Environment *env);
+
+  void visitBinaryExpr(const BinaryExpr &expr) override;
+  void visitLogicalExpr(const LogicalExpr &expr) override;
+  void visitUnaryExpr(const UnaryExpr &expr) override;
+  void visitLiteralExpr(const LiteralExpr &expr) override;
+  void visitGroupingExpr(const GroupingExpr &expr) override;
+  void visitVariableExpr(const VariableExpr &expr) override;
+  void visitAssignExpr(const AssignExpr &expr) override;
+  void visitCallExpr(const CallExpr &expr) override;
+  void visitGetExpr(const GetExpr &expr) override;
+  void visitSetExpr(const SetExpr &expr) override;
+  void visitThisExpr(const ThisExpr &expr) override;
+  void visitSuperExpr(const SuperExpr &expr) override;
+
+  void visitExpressionStmt(const ExpressionStmt &stmt) override;
+  void visitClassStmt(const ClassStmt &stmt) override;
+  void visitFunctionStmt(const FunctionStmt &stmt) override;
+  void visitIfStmt(const IfStmt &stmt) override;
+  void visitPrintStmt(const PrintStmt &stmt) override;
+  void visitVarStmt(const VarStmt &stmt) override;
+  void visitWhileStmt(const WhileStmt &stmt) override;
+  void visitBlockStmt(const BlockStmt &stmt) override;
+  void visitBreakStmt(const BreakStmt &stmt) override;
+  void visitContinueStmt(const ContinueStmt &stmt) override;
+  void visitReturnStmt(const ReturnStmt &stmt) override;
+
+private:
+  ExprCode compile(const Expr &expr);
+  StmtCode compile(const Stmt &stmt);
+  CompiledBlock compileBlock(const std::vector<Stmt *> &statements);
+  const CompiledBlock *compileFunction(const FunctionStmt &function);
+  ExprCode variable(const Token &name, LocalSlot local);
+  template <typename Operation>
+  ExprCode numeric(const BinaryExpr &expr, Operation operation);
+
+  static Completion run(Interpreter &interpreter, const CompiledBlock &block);
+  static std::span<const Value>
+  evaluateArguments(Interpreter &interpreter, const CallExpr &expr,
+                    const std::vector<ExprCode> &arguments,
+                    Interpreter::Roots &roots);
+  static Value call(Interpreter &interpreter, const CallExpr &expr,
+                    const std::vector<ExprCode> &arguments, Value callee,
+                    Interpreter::Roots &roots);
+
+  Interpreter &m_interpreter;
+  ExprCode m_expr; // Result of the last visit*Expr
+  StmtCode m_stmt; // Result of the last visit*Stmt
+  // Function bodies, which LoxFunctions point to
+  std::deque<CompiledBlock> m_functions;
+};
+
+#endif // CLOSURE_COMPILER_H_
@@ -0,0 +1,582 @@
+#include "Compiler.h"
+#include "Heap.h"
+#include "VM.h"
+#include "error.h"
+#include <cstdint>
+#include <algorithm>
+
+ObjFunction *Compiler::compile(const std::vector<Stmt *> &statements) {
+  Heap &heap = m_vm.heap();
+  // Functions under construction are not reachable from the VM's roots.
+  heap.pause();
+
+  FunctionState script{nullptr, heap.allocate<ObjFunction>(),
+                       FunctionType::SCRIPT};
+  script.locals.push_back({"", 0, false}); // Slot 0 holds the callee
+  m_current = &script;
+
+  for (const Stmt *statement : statements) {
+    compile(*statement);
+  }
+  emitReturn();
+  heap.resized(script.function); // Charge the finished chunk
+
+  m_current = nullptr;
+  heap.resume();
+  return m_hadError ? nullptr : script.function;
+}
+
+// Expressions
+
+void Compiler::visitBinaryExpr(const BinaryExpr &expr) {
+  compile(expr.left);
+  compile(expr.right);
+
+  switch (expr.opcode) {
+  case BinaryOp::ADD:
+    emit(OpCode::ADD, expr.op);
+    break;
+  case BinaryOp::SUBTRACT:
+    emit(OpCode::SUBTRACT, expr.op);
+    break;
+  case BinaryOp::MULTIPLY:
+    emit(OpCode::MULTIPLY, expr.op);
+    break;
+  case BinaryOp::DIVIDE:
+    emit(OpCode::DIVIDE, expr.op);
+    break;
+  case BinaryOp::GREATER:
+    emit(OpCode::GREATER, expr.op);
+    break;
+  case BinaryOp::GREATER_EQUAL:
+    emit(OpCode::GREATER_EQUAL, expr.op);
+    break;
+  case BinaryOp::LESS:
+    emit(OpCode::LESS, expr.op);
+    break;
+  case BinaryOp::LESS_EQUAL:
+    emit(OpCode::LESS_EQUAL, expr.op);
+    break;
+  case BinaryOp::EQUAL:
+    emit(OpCode::EQUAL);
+    break;
+  case BinaryOp::NOT_EQUAL:
+    emit(OpCode::NOT_EQUAL);
+    break;
+  }
+}
+
+void Compiler::visitLogicalExpr(const LogicalExpr &expr) {
+  compile(expr.left);
+  if (expr.opcode == LogicalOp::OR) {
+    size_t elseJump = emitJump(OpCode::JUMP_IF_FALSE);
+    size_t endJump = emitJump(OpCode::JUMP);
+    patchJump(elseJump);
+    emit(OpCode::POP);
+    compile(expr.right);
+    patchJump(endJump);
+  } else {
+    size_t endJump = emitJump(OpCode::JUMP_IF_FALSE);
+    emit(OpCode::POP);
+    compile(expr.right);
+    patchJump(endJump);
+  }
+}
+
+void Compiler::visitUnaryExpr(const UnaryExpr &expr) {
+  compile(expr.right);
+  if (expr.opcode == UnaryOp::NEGATE) {
+    emit(OpCode::NEGATE, expr.op);
+  } else {
+    emit(OpCode::NOT);
+  }
+}
+
+void Compiler::visitLiteralExpr(const LiteralExpr &expr) {
+  Value value = expr.value;
+  if (value.isNil()) {
+    emit(OpCode::NIL);
+  } else if (value.isBool()) {
+    emit(value.asBool() ? OpCode::TRUE : OpCode::FALSE);
+  } else if (value.isNumber()) {
+    emitConstant(value);
+  } else if (isObjType(value, ObjType::STRING)) {
+    // The literal's string belongs to the AST; the VM wants its own interned
+    // copy so that string identity is string equality.
+    const std::string &chars = static_cast<ObjString *>(value.asObj())->chars;
+    emitConstant(m_vm.heap().intern(std::string_view(chars)));
+  }
+}
+
+void Compiler::visitGroupingExpr(const GroupingExpr &expr) {
+  compile(expr.expr);
+}
+
+void Compiler::visitVariableExpr(const VariableExpr &expr) {
+  namedVariable(expr.name, false);
+}
+
+void Compiler::visitAssignExpr(const AssignExpr &expr) {
+  compile(expr.value);
+  namedVariable(expr.name, true);
+}
+
+void Compiler::visitCallExpr(const CallExpr &expr) {
+  // `object.method(...)` is a single INVOKE, which calls the method without
+  // creating a bound method. A missing property is reported at its name and
+  // a bad call at the parenthesis, as with GET_PROPERTY followed by CALL.
+  if (auto *get = dynamic_cast<const GetExpr *>(&expr.callee)) {
+    compile(get->object);
+    for (const Expr *argument : expr.arguments) {
+      compile(*argument);
+    }
+    emit(OpCode::INVOKE, get->name);
+    emitLong(identifierConstant(get->name.lexeme));
+    chunk().write(static_cast<uint8_t>(expr.arguments.size()), expr.paren);
+    return;
+  }
+
+  compile(expr.callee);
+  for (const Expr *argument : expr.arguments) {
+    compile(*argument);
+  }
+  emit(OpCode::CALL, expr.paren);
+  emit(static_cast<uint8_t>(expr.arguments.size()));
+}
+
+void Compiler::visitGetExpr(const GetExpr &expr) {
+  compile(expr.object);
+  emit(OpCode::GET_PROPERTY, expr.name);
+  emitLong(identifierConstant(expr.name.lexeme));
+}
+
+void Compiler::visitSetExpr(const SetExpr &expr) {
+  compile(expr.object);
+  compile(expr.value);
+  emit(OpCode::SET_PROPERTY, expr.name);
+  emitLong(identifierConstant(expr.name.lexeme));
+}
+
+void Compiler::visitThisExpr(const ThisExpr &expr) {
+  namedVariable(expr.keyword, false);
+}
+
+void Compiler::visitSuperExpr(const SuperExpr &expr) {
+  namedVariable(Token(TokenType::THIS, "this", expr.keyword.line), false);
+  namedVariable(expr.keyword, false);
+  emit(OpCode::GET_SUPER, expr.method);
+  emitLong(identifierConstant(expr.method.lexeme));
+}
+
+// Statements
+
+void Compiler::visitExpressionStmt(const ExpressionStmt &stmt) {
+  compile(stmt.expression);
+  emit(OpCode::POP);
+}
+
+void Compiler::visitClassStmt(const ClassStmt &stmt) {
+  declareVariable(stmt.name);
+  emit(OpCode::CLASS);
+  emitLong(identifierConstant(stmt.name.lexeme));
+  defineVariable(stmt.name);
+
+  if (stmt.superclass) {
+    compile(*stmt.superclass);
+    // The superclass stays on the stack as a local named "super" that the
+    // methods capture.
+    beginScope();
+    addLocal("super");
+    markInitialized();
+
+    namedVariable(stmt.name, false);
+    emit(OpCode::INHERIT, stmt.superclass->name);
+  }
+
+  namedVariable(stmt.name, false);
+  for (const FunctionStmt *method : stmt.methods) {
+    FunctionType type = method->name.lexeme == "init"
+                            ? FunctionType::INITIALIZER
+                            : FunctionType::METHOD;
+    function(*method, type);
+    emit(OpCode::METHOD);
+    emitLong(identifierConstant(method->name.lexeme));
+  }
+  emit(OpCode::POP);
+
+  if (stmt.superclass) {
+    endScope();
+  }
+}
+
+void Compiler::visitFunctionStmt(const FunctionStmt &stmt) {
+  declareVariable(stmt.name);
+  // A local function may refer to itself recursively.
+  if (m_current->scopeDepth > 0)
+    markInitialized();
+  function(stmt, FunctionType::FUNCTION);
+  defineVariable(stmt.name);
+}
+
+void Compiler::visitIfStmt(const IfStmt &stmt) {
+  compile(stmt.condition);
+  size_t thenJump = emitJump(OpCode::JUMP_IF_FALSE);
+  emit(OpCode::POP);
+  compile(stmt.thenBranch);
+
+  size_t elseJump = emitJump(OpCode::JUMP);
+  patchJump(thenJump);
+  emit(OpCode::POP);
+  if (stmt.elseBranch)
+    compile(*stmt.elseBranch);
+  patchJump(elseJump);
+}
+
+void Compiler::visitPrintStmt(const PrintStmt &stmt) {
+  compile(stmt.expression);
+  emit(OpCode::PRINT);
+}
+
+void Compiler::visitVarStmt(const VarStmt &stmt) {
+  declareVariable(stmt.name);
+  if (stmt.initializer) {
+    compile(*stmt.initializer);
+  } else {
+    emit(OpCode::NIL);
+  }
+  defineVariable(stmt.name);
+}
+
+/*
+ * loopStart:  condition
+ *             JUMP_IF_FALSE exit
+ *             POP
+ *             body               <- break jumps to `done`
+ * continue:   increment          <- continue jumps here
+ *             LOOP loopStart
+ * exit:       POP
+ * done:
+ */
+void Compiler::visitWhileStmt(const WhileStmt &stmt) {
+  size_t loopStart = chunk().code.size();
+  compile(stmt.condition);
+  size_t exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+  emit(OpCode::POP);
+
+  m_current->loops.push_back({m_current->scopeDepth, {}, {}});
+  compile(stmt.body);
+
+  Loop loop = std::move(m_current->loops.back());
+  m_current->loops.pop_back();
+
+  for (size_t jump : loop.continueJumps) {
+    patchJump(jump);
+  }
+  if (stmt.increment)
+    compile(*stmt.increment);
+  emitLoop(loopStart);
+
+  patchJump(exitJump);
+  emit(OpCode::POP);
+  for (size_t jump : loop.breakJumps) {
+    patchJump(jump);
+  }
+}
+
+void Compiler::visitBlockStmt(const BlockStmt &stmt) {
+  beginScope();
+  for (const Stmt *statement : stmt.statements) {
+    compile(*statement);
+  }
+  endScope();
+}
+
+void Compiler::visitBreakStmt(const BreakStmt &stmt) {
+  if (m_current->loops.empty()) {
+    error(stmt.keyword, "Cannot use 'break' outside of a loop.");
+    return;
+  }
+  discardLocals(m_current->loops.back().scopeDepth);
+  m_current->loops.back().breakJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::visitContinueStmt(const ContinueStmt &stmt) {
+  if (m_current->loops.empty()) {
+    error(stmt.keyword, "Cannot use 'continue' outside of a loop.");
+    return;
+  }
+  discardLocals(m_current->loops.back().scopeDepth);
+  m_current->loops.back().continueJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::visitReturnStmt(const ReturnStmt &stmt) {
+  if (stmt.value) {
+    compile(*stmt.value);
+    emit(OpCode::RETURN);
+  } else {
+    emitReturn();
+  }
+}
+
+// Code emission helpers
+
+void Compiler::emitShort(size_t operand) {
+  emit(static_cast<uint8_t>((operand >> 8) & 0xff));
+  emit(static_cast<uint8_t>(operand & 0xff));
+}
+
+void Compiler::emitLong(size_t operand) {
+  emit(static_cast<uint8_t>((operand >> 16) & 0xff));
+  emitShort(operand & 0xffff);
+}
+
+void Compiler::emitIndexed(OpCode op, OpCode longOp, int width,
+                           size_t operand, const Token *site) {
+  bool fits = operand >> (8 * width) == 0;
+  if (site) {
+    emit(fits ? op : longOp, *site);
+  } else {
+    emit(fits ? op : longOp);
+  }
+  if (!fits) {
+    emitLong(operand);
+  } else if (width == 1) {
+    emit(static_cast<uint8_t>(operand));
+  } else {
+    emitShort(operand);
+  }
+}
+
+void Compiler::emitConstant(Value value) {
+  emitIndexed(OpCode::CONSTANT, OpCode::CONSTANT_LONG, 2, makeConstant(value));
+}
+
+size_t Compiler::makeConstant(Value value) {
+  size_t constant = chunk().addConstant(value);
+  if (constant > kLongOperandMax) {
+    lox::error(m_line, "Too many constants in one chunk.");
+    m_hadError = true;
+    return 0;
+  }
+  return constant;
+}
+
+size_t Compiler::identifierConstant(std::string_view name) {
+  return makeConstant(m_vm.heap().intern(name));
+}
+
+size_t Compiler::emitJump(OpCode op) {
+  emit(op);
+  emitLong(kLongOperandMax);
+  return chunk().code.size() - 3;
+}
+
+void Compiler::patchJump(size_t offset) {
+  // -3 to adjust for the bytecode for the jump offset itself.
+  size_t jump = chunk().code.size() - offset - 3;
+  if (jump > kLongOperandMax) {
+    lox::error(m_line, "Too much code to jump over.");
+    m_hadError = true;
+  }
+  chunk().code[offset] = (jump >> 16) & 0xff;
+  chunk().code[offset + 1] = (jump >> 8) & 0xff;
+  chunk().code[offset + 2] = jump & 0xff;
+}
+
+void Compiler::emitLoop(size_t loopStart) {
+  emit(OpCode::LOOP);
+  size_t offset = chunk().code.size() - loopStart + 3;
+  if (offset > kLongOperandMax) {
+    lox::error(m_line, "Loop body too large.");
+    m_hadError = true;
+  }
+  emitLong(offset);
+}
+
+void Compiler::emitReturn() {
+  if (m_current->type == FunctionType::INITIALIZER) {
+    emit(OpCode::GET_LOCAL);
+    emit(0);
+  } else {
+    emit(OpCode::NIL);
+  }
+  emit(OpCode::RETURN);
+}
+
+// Scopes and variables
+
+void Compiler::beginScope() { m_current->scopeDepth++; }
+
+void Compiler::endScope() {
+  m_current->scopeDepth--;
+  std::vector<Local> &locals = m_current->locals;
+  while (!locals.empty() && locals.back().depth > m_current->scopeDepth) {
+    emit(locals.back().isCaptured ? OpCode::CLOSE_UPVALUE : OpCode::POP);
+    locals.pop_back();
+  }
+}
+
+void Compiler::discardLocals(int depth) {
+  const std::vector<Local> &locals = m_current->locals;
+  for (auto it = locals.rbegin(); it != locals.rend() && it->depth > depth;
+       ++it) {
+    emit(it->isCaptured ? OpCode::CLOSE_UPVALUE : OpCode::POP);
+  }
+}
+
+void Compiler::declareVariable(const Token &name) {
+  if (m_current->scopeDepth == 0)
+    return;
+  if (m_current->locals.size() > kLongOperandMax) {
+    error(name, "Too many local variables in function.");
+    return;
+  }
+  addLocal(name.lexeme);
+}
+
+void Compiler::defineVariable(const Token &name) {
+  if (m_current->scopeDepth > 0) {
+    markInitialized();
+    return;
+  }
+  size_t global = m_vm.globalSlot(name.symbol);
+  if (global > kLongOperandMax) {
+    error(name, "Too many global variables.");
+    return;
+  }
+  emitIndexed(OpCode::DEFINE_GLOBAL, OpCode::DEFINE_GLOBAL_LONG, 2, global);
+}
+
+void Compiler::addLocal(std::string_view name) {
+  std::vector<Local> &locals = m_current->locals;
+  locals.push_back({name, -1, false});
+  ObjFunction *function = m_current->function;
+  function->maxSlots =
+      std::max(function->maxSlots, static_cast<int>(locals.size()));
+}
+
+void Compiler::markInitialized() {
+  if (m_current->scopeDepth == 0)
+    return;
+  m_current->locals.back().depth = m_current->scopeDepth;
+}
+
+int Compiler::resolveLocal(FunctionState &state, std::string_view name) {
+  for (int i = static_cast<int>(state.locals.size()) - 1; i >= 0; i--) {
+    if (state.locals[i].name == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int Compiler::resolveUpvalue(FunctionState &state, std::string_view name) {
+  if (state.enclosing == nullptr)
+    return -1;
+
+  int local = resolveLocal(*state.enclosing, name);
+  if (local != -1) {
+    state.enclosing->locals[local].isCaptured = true;
+    return addUpvalue(state, static_cast<uint32_t>(local), true);
+  }
+
+  int upvalue = resolveUpvalue(*state.enclosing, name);
+  if (upvalue != -1) {
+    return addUpvalue(state, static_cast<uint32_t>(upvalue), false);
+  }
+  return -1;
+}
+
+int Compiler::addUpvalue(FunctionState &state, uint32_t index, bool isLocal) {
+  for (size_t i = 0; i < state.upvalues.size(); i++) {
+    if (state.upvalues[i].index == index &&
+        state.upvalues[i].isLocal == isLocal) {
+      return static_cast<int>(i);
+    }
+  }
+  if (state.upvalues.size() > kLongOperandMax) {
+    lox::error(m_line, "Too many closure variables in function.");
+    m_hadError = true;
+    return 0;
+  }
+  state.upvalues.push_back({index, isLocal});
+  return static_cast<int>(state.upvalues.size()) - 1;
+}
+
+void Compiler::namedVariable(const Token &name, bool isAssignment) {
+  int arg = resolveLocal(*m_current, name.lexeme);
+  if (arg != -1) {
+    if (isAssignment) {
+      emitIndexed(OpCode::SET_LOCAL, OpCode::SET_LOCAL_LONG, 1, arg);
+    } else {
+      emitIndexed(OpCode::GET_LOCAL, OpCode::GET_LOCAL_LONG, 1, arg);
+    }
+    return;
+  }
+
+  arg = resolveUpvalue(*m_current, name.lexeme);
+  if (arg != -1) {
+    if (isAssignment) {
+      emitIndexed(OpCode::SET_UPVALUE, OpCode::SET_UPVALUE_LONG, 1, arg);
+    } else {
+      emitIndexed(OpCode::GET_UPVALUE, OpCode::GET_UPVALUE_LONG, 1, arg);
+    }
+    return;
+  }
+
+  size_t global = m_vm.globalSlot(name.symbol);
+  if (global > kLongOperandMax) {
+    error(name, "Too many global variables.");
+    return;
+  }
+  if (isAssignment) {
+    emitIndexed(OpCode::SET_GLOBAL, OpCode::SET_GLOBAL_LONG, 2, global, &name);
+  } else {
+    emitIndexed(OpCode::GET_GLOBAL, OpCode::GET_GLOBAL_LONG, 2, global, &name);
+  }
+}
+
+void Compiler::function(const FunctionStmt &stmt, FunctionType type) {
+  Heap &heap = m_vm.heap();
+  FunctionState state{m_current, heap.allocate<ObjFunction>(), type};
+  state.function->name = heap.intern(stmt.name.lexeme);
+  state.function->arity = static_cast<int>(stmt.params.size());
+  // Slot 0 holds the receiver in methods and the callee otherwise.
+  bool hasReceiver =
+      type == FunctionType::METHOD || type == FunctionType::INITIALIZER;
+  state.locals.push_back({hasReceiver ? "this" : "", 0, false});
+  m_current = &state;
+
+  // Parameters and the top-level body share one scope, as in the Resolver.
+  beginScope();
+  for (const Token &param : stmt.params) {
+    declareVariable(param);
+    markInitialized();
+  }
+  for (const Stmt *statement : stmt.body) {
+    compile(*statement);
+  }
+  emitReturn();
+
+  m_current = state.enclosing;
+  ObjFunction *function = state.function;
+  function->upvalueCount = static_cast<int>(state.upvalues.size());
+  heap.resized(function); // Charge the finished chunk
+
+  emit(OpCode::CLOSURE);
+  emitLong(makeConstant(function));
+  for (const Upvalue &upvalue : state.upvalues) {
+    emit(upvalue.isLocal ? 1 : 0);
+    emitLong(upvalue.index);
+  }
+}
+
+void Compiler::emit(OpCode op, const Token &site) {
+  m_line = site.line;
+  chunk().write(op, site);
+}
+
+void Compiler::error(const Token &token, const std::string &message) {
+  lox::error(token, message);
+  m_hadError = true;
+}
@@ -0,0 +1,132 @@
+#ifndef COMPILER_H_
+#define COMPILER_H_
+#pragma once
+
+#include "Chunk.h"
+#include "Expr.hpp"
+#include "Object.h"
+#include "Stmt.hpp"
+#include <string>
+#include <vector>
+
+class VM;
+
+/**
+ * Lowers a resolved program into bytecode for the VM.
+ *
+ * The Resolver has already rejected invalid programs, so the compiler only
+ * re-derives what it needs for code generation: which names are locals (and
+ * in which stack slot), which are captured as upvalues, and which are globals.
+ */
+class Compiler : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+  explicit Compiler(VM &vm) : m_vm(vm) {}
+
+  // Returns the top-level script function, or nullptr on a compile error.
+  ObjFunction *compile(const std::vector<Stmt *> &statements);
+
+  void visitBinaryExpr(const BinaryExpr &expr) override;
+  void visitLogicalExpr(const LogicalExpr &expr) override;
+  void visitUnaryExpr(const UnaryExpr &expr) override;
+  void visitLiteralExpr(const LiteralExpr &expr) override;
+  void visitGroupingExpr(const GroupingExpr &expr) override;
+  void visitVariableExpr(const VariableExpr &expr) override;
+  void visitAssignExpr(const AssignExpr &expr) override;
+  void visitCallExpr(const CallExpr &expr) override;
+  void visitGetExpr(const GetExpr &expr) override;
+  void visitSetExpr(const SetExpr &expr) override;
+  void visitThisExpr(const ThisExpr &expr) override;
+  void visitSuperExpr(const SuperExpr &expr) override;
+
+  void visitExpressionStmt(const ExpressionStmt &stmt) override;
+  void visitClassStmt(const ClassStmt &stmt) override;
+  void visitFunctionStmt(const FunctionStmt &stmt) override;
+  void visitIfStmt(const IfStmt &stmt) override;
+  void visitPrintStmt(const PrintStmt &stmt) override;
+  void visitVarStmt(const VarStmt &stmt) override;
+  void visitWhileStmt(const WhileStmt &stmt) override;
+  void visitBlockStmt(const BlockStmt &stmt) override;
+  void visitBreakStmt(const BreakStmt &stmt) override;
+  void visitContinueStmt(const ContinueStmt &stmt) override;
+  void visitReturnStmt(const ReturnStmt &stmt) override;
+
+private:
+  enum class FunctionType { SCRIPT, FUNCTION, METHOD, INITIALIZER };
+
+  struct Local {
+    std::string_view name;
+    int depth; // -1 while declared but not yet initialized
+    bool isCaptured;
+  };
+
+  struct Upvalue {
+    uint32_t index;
+    bool isLocal;
+  };
+
+  struct Loop {
+    int scopeDepth; // Scope depth outside the loop body
+    std::vector<size_t> breakJumps;
+    std::vector<size_t> continueJumps;
+  };
+
+  // Per-function compilation state; nested function declarations push a new
+  // one that points back at its enclosing function.
+  struct FunctionState {
+    FunctionState *enclosing;
+    ObjFunction *function;
+    FunctionType type;
+    std::vector<Local> locals;
+    std::vector<Upvalue> upvalues;
+    std::vector<Loop> loops;
+    int scopeDepth = 0;
+  };
+
+  void compile(const Expr &expr) { expr.accept(*this); }
+  void compile(const Stmt &stmt) { stmt.accept(*this); }
+
+  Chunk &chunk() { return m_current->function->chunk; }
+  void emit(uint8_t byte) { chunk().write(byte); }
+  void emit(OpCode op) { chunk().write(op); }
+  void emit(OpCode op, const Token &site);
+  void emitShort(size_t operand);
+  void emitLong(size_t operand);
+  // Emits `op` with a `width`-byte operand (1 or 2), or `longOp` with a u24
+  // operand if it doesn't fit. `site`, if set, is where the instruction can
+  // fail.
+  void emitIndexed(OpCode op, OpCode longOp, int width, size_t operand,
+                   const Token *site = nullptr);
+  void emitConstant(Value value);
+  size_t makeConstant(Value value);
+  size_t identifierConstant(std::string_view name);
+  size_t emitJump(OpCode op);
+  void patchJump(size_t offset);
+  void emitLoop(size_t loopStart);
+  void emitReturn();
+
+  void beginScope();
+  void endScope();
+  // Emits the pops needed to discard locals deeper than `depth` without
+  // forgetting them (used by break/continue).
+  void discardLocals(int depth);
+
+  void declareVariable(const Token &name);
+  void defineVariable(const Token &name);
+  void addLocal(std::string_view name);
+  void markInitialized();
+  int resolveLocal(FunctionState &state, std::string_view name);
+  int resolveUpvalue(FunctionState &state, std::string_view name);
+  int addUpvalue(FunctionState &state, uint32_t index, bool isLocal);
+  void namedVariable(const Token &name, bool isAssignment);
+
+  void function(const FunctionStmt &stmt, FunctionType type);
+
+  void error(const Token &token, const std::string &message);
+
+  VM &m_vm;
+  FunctionState *m_current = nullptr;
+  int m_line = 0; // Line of the last instruction with a source site
+  bool m_hadError = false;
+};
+
+#endif // COMPILER_H_
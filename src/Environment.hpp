@@ -3,80 +3,128 @@
 #pragma once
 
 #include "EnvironmentPrinter.h"
-#include "Expr.hpp"
+#include "GlobalTable.hpp"
+#include "Stmt.hpp"
+#include "Heap.h"
 #include "error.h"
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
-class Environment : public std::enable_shared_from_this<Environment> {
-  // Make EnvironmentPrinter a friend class so it can access m_values and
+// The single-variable scope that holds `super` for subclass methods
+inline const ScopeLayout kSuperScope{{internSymbol("super")}};
+
+/**
+ * A runtime scope.
+ *
+ * Only locals that closures capture live in a local scope; the rest live in
+ * the Interpreter's stack frames. A local scope stores them in a slot array
+ * laid out by the Resolver, so reading one is a walk up `depth` enclosing
+ * scopes plus an index. The global scope stores its variables by GlobalTable index, with
+ * empty values for globals that haven't been defined (yet).
+ *
+ * Closures and bound methods keep scopes alive past the block that created
+ * them, so environments are heap objects owned by the Interpreter's Heap.
+ */
+class Environment : public Obj {
+  // Make EnvironmentPrinter a friend class so it can access the variables and
   // enclosing
   friend void formatEnvironmentRecursive(std::stringstream &ss,
                                          const Environment *env, size_t depth);
 
 public:
-  Environment() = default;
-  explicit Environment(std::shared_ptr<Environment> enclosing)
-      : enclosing(std::move(enclosing)) {}
-
-  void define(const std::string &name, const LiteralValue &value) {
-    m_values[name] = value;
-  }
+  // The global scope, whose variables `names` numbers
+  explicit Environment(const GlobalTable &names)
+      : Obj(ObjType::ENVIRONMENT), m_globalNames(&names) {}
 
-  LiteralValue get(const Token &name) {
-    if (m_values.find(name.lexeme) != m_values.end()) {
-      return m_values.at(name.lexeme);
+  Environment(Environment *enclosing, const ScopeLayout &layout)
+      : Obj(ObjType::ENVIRONMENT), enclosing(enclosing), m_layout(&layout) {
+    // Small scopes, which include most function calls, keep their slots in
+    // the object itself and cost a single allocation.
+    if (layout.names.size() > kInlineSlots) {
+      m_overflow = std::make_unique<Value[]>(layout.names.size());
+      m_slots = m_overflow.get();
     }
-    if (enclosing != nullptr)
-      return enclosing->get(name);
-
-    throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
   }
 
-  LiteralValue getAt(int distance, const Token &name) {
-    std::shared_ptr<Environment> environment = shared_from_this();
-    for (int i = 0; i < distance; i++) {
-      environment = environment->enclosing;
+  void trace(Heap &heap) override {
+    heap.markObject(enclosing);
+    for (uint32_t slot = 0; slot < m_slotCount; slot++) {
+      heap.markValue(m_slots[slot]);
     }
-    auto it = environment->m_values.find(name.lexeme);
-    if (it != environment->m_values.end()) {
-      return it->second;
+    for (Value value : m_globals) {
+      heap.markValue(value);
     }
-    throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
   }
 
-  void assign(const Token &name, const LiteralValue &value) {
-    if (m_values.find(name.lexeme) != m_values.end()) {
-      m_values[name.lexeme] = value;
-      return;
+  // Global variables
+
+  // Charges `heap` when the table of globals grows
+  void defineGlobal(Heap &heap, uint32_t index, Value value) {
+    if (index >= m_globals.size()) {
+      m_globals.resize(m_globalNames->size(), Value::empty());
+      heap.resized(this);
     }
-    if (enclosing != nullptr) {
-      enclosing->assign(name, value);
-      return;
+    m_globals[index] = value;
+  }
+
+  Value getGlobal(const Token &name, uint32_t index) {
+    if (index >= m_globals.size() || m_globals[index].isEmpty()) {
+      throw RuntimeError(name, "Undefined variable '" +
+                                   std::string(name.lexeme) + "'.");
     }
+    return m_globals[index];
+  }
 
-    throw RuntimeError(name, "Undefined variable '" + name.lexeme + "'.");
+  void assignGlobal(const Token &name, uint32_t index, Value value) {
+    getGlobal(name, index); // Only defined globals can be assigned
+    m_globals[index] = value;
   }
 
-  void assignAt(int distance, const Token &name, const LiteralValue &value) {
-    std::shared_ptr<Environment> environment = shared_from_this();
-    for (int i = 0; i < distance; i++) {
-      environment = environment->enclosing;
-    }
-    // Assuming the resolver guarantees the variable exists at this distance.
-    environment->m_values[name.lexeme] = value;
+  // Local variables. Declarations execute in the order the Resolver numbered
+  // them, so defining a local simply takes the next slot.
+
+  void define(Value value) { m_slots[m_slotCount++] = value; }
+
+  Value getAt(LocalSlot local) {
+    return ancestor(local.depth)->m_slots[local.slot];
+  }
+
+  void assignAt(LocalSlot local, Value value) {
+    ancestor(local.depth)->m_slots[local.slot] = value;
   }
 
   // Returns a string representation of the environment chain by calling the
   // helper
-  std::string toString() const { return formatEnvironment(*this); }
+  std::string toString() const override { return formatEnvironment(*this); }
+
+  size_t size() const override {
+    size_t overflow = m_overflow ? m_layout->names.size() * sizeof(Value) : 0;
+    return sizeof(Environment) + overflow + storageBytes(m_globals);
+  }
 
 public:
-  std::shared_ptr<Environment> enclosing = nullptr;
+  Environment *enclosing = nullptr;
 
 private:
-  std::unordered_map<std::string, LiteralValue> m_values;
+  Environment *ancestor(int distance) {
+    Environment *environment = this;
+    for (int i = 0; i < distance; i++) {
+      environment = environment->enclosing;
+    }
+    return environment;
+  }
+
+  static constexpr size_t kInlineSlots = 4;
+
+  const ScopeLayout *m_layout = nullptr; // nullptr for the global scope
+  Value *m_slots = m_inlineSlots;        // Or m_overflow's, for big scopes
+  uint32_t m_slotCount = 0;              // Slots defined so far
+  Value m_inlineSlots[kInlineSlots];
+  std::unique_ptr<Value[]> m_overflow;
+  const GlobalTable *m_globalNames = nullptr; // Global scope only
+  std::vector<Value> m_globals;              // Indexed like m_globalNames
 };
 
 #endif // ENVIRONMENT_H_
@@ -1,54 +1,53 @@
 #include "EnvironmentPrinter.h"
 #include "Environment.hpp" // Need full definition here
-#include "LoxCallable.h"   // For LiteralValue and LoxCallable
-#include "LoxInstance.h"
+#include "Value.h"
 #include <algorithm> // For std::max
 #include <cmath>     // For std::isinf, std::isnan
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
-// Helper struct to print LiteralValue variants
-struct LiteralPrinter {
-  std::string operator()(const std::string &s) const { return "\"" + s + "\""; }
-  std::string operator()(bool b) const { return b ? "true" : "false"; }
-  std::string operator()(int d) const { return std::to_string(d); }
-  std::string operator()(double d) const {
-    std::string s = std::to_string(d);
-    s.erase(s.find_last_not_of('0') + 1);
-    if (!s.empty() && s.back() == '.') {
-      s.pop_back();
-    }
-    if (s == "-")
-      s = "-0";
-    if (s.empty() && std::isinf(d))
-      return d > 0 ? "inf" : "-inf";
-    if (s.empty() && std::isnan(d))
-      return "nan";
-    if (s.empty())
-      return "0";
-    return s;
-  }
-  std::string operator()(std::nullptr_t) const { return "nil"; }
-  std::string operator()(const std::shared_ptr<LoxCallable> &callable) const {
-    return callable ? callable->toString() : "nil";
+// Prints a variable's value, spelling out numbers that std::to_string can't
+// show after trimming
+static std::string printValue(Value value) {
+  if (!value.isNumber()) {
+    return valueToString(value);
   }
-  std::string operator()(const std::shared_ptr<LoxInstance> &instance) const {
-    return instance ? instance->toString() : "nil";
+  double d = value.asNumber();
+  std::string s = std::to_string(d);
+  s.erase(s.find_last_not_of('0') + 1);
+  if (!s.empty() && s.back() == '.') {
+    s.pop_back();
   }
-};
+  if (s == "-")
+    s = "-0";
+  if (s.empty() && std::isinf(d))
+    return d > 0 ? "inf" : "-inf";
+  if (s.empty() && std::isnan(d))
+    return "nan";
+  if (s.empty())
+    return "0";
+  return s;
+}
 
-// Recursive helper function to build the string representation
-void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
-                                size_t depth) {
-  if (!env)
-    return;
+// Names a table after what it shows and where that lives
+static std::string tableTitle(const std::string &kind, const void *address) {
+  std::stringstream title;
+  title << " " << kind << " (0x" << std::hex
+        << reinterpret_cast<uintptr_t>(address) << ") ";
+  return title.str();
+}
 
+// Writes one scope as a table of name/value rows
+static void formatScopeTable(
+    std::stringstream &ss, const std::string &scopeText,
+    const std::vector<std::pair<std::string, std::string>> &rows) {
   // Define exact field widths matching the image
   const int nameFieldWidth = 26; // Adjusted from 25
   const int valueFieldWidth = 35;
   const int innerWidth =
-      nameFieldWidth + 1 + valueFieldWidth;  // 26 + 1 + 35 = 62
-  const int totalWidth = 1 + innerWidth + 1; // 1 + 62 + 1 = 64
+      nameFieldWidth + 1 + valueFieldWidth; // 26 + 1 + 35 = 62
 
   // Top border:
   // +--------------------------+-----------------------------------+
@@ -56,11 +55,6 @@ void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
      << std::string(valueFieldWidth, '-') << "+\n";
 
   // Scope header: |            SCOPE 0 (0xaddr)           |
-  std::stringstream scope_ss;
-  // Use std::hex to format the pointer address
-  scope_ss << " SCOPE " << depth << " (0x" << std::hex
-           << reinterpret_cast<uintptr_t>(env) << ") ";
-  std::string scopeText = scope_ss.str();
   int scopePaddingTotal = innerWidth - scopeText.length();
   scopePaddingTotal = std::max(0, scopePaddingTotal);
   int scopePaddingLeft = scopePaddingTotal / 2;
@@ -73,7 +67,7 @@ void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
   ss << "+" << std::string(nameFieldWidth, '-') << "+"
      << std::string(valueFieldWidth, '-') << "+\n";
 
-  if (env->m_values.empty()) {
+  if (rows.empty()) {
     // Empty message: |     [No variables defined in this scope]      |
     std::string emptyMsg = " [No variables defined in this scope] ";
     int emptyPaddingTotal = innerWidth - emptyMsg.length();
@@ -83,7 +77,7 @@ void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
     ss << "|" << std::string(emptyPaddingLeft, ' ') << emptyMsg
        << std::string(emptyPaddingRight, ' ') << "|\n";
   } else {
-    for (const auto &[name, value] : env->m_values) {
+    for (const auto &[name, value] : rows) {
       // Data row: | name                     | value |
 
       std::string nameStr = name;
@@ -91,7 +85,7 @@ void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
         nameStr = nameStr.substr(0, nameFieldWidth - 5) + "...";
       }
 
-      std::string valueStr = std::visit(LiteralPrinter{}, value);
+      std::string valueStr = value;
       if (valueStr.length() > valueFieldWidth - 2) {
         valueStr = valueStr.substr(0, valueFieldWidth - 5) + "...";
       }
@@ -112,11 +106,36 @@ void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
   // +--------------------------+-----------------------------------+
   ss << "+" << std::string(nameFieldWidth, '-') << "+"
      << std::string(valueFieldWidth, '-') << "+\n";
+}
+
+// Recursive helper function to build the string representation
+void formatEnvironmentRecursive(std::stringstream &ss, const Environment *env,
+                                size_t depth) {
+  if (!env)
+    return;
+
+  std::vector<std::pair<std::string, std::string>> rows;
+  if (env->m_layout != nullptr) {
+    for (size_t slot = 0; slot < env->m_slotCount; slot++) {
+      rows.emplace_back(symbolName(env->m_layout->names[slot]),
+                        printValue(env->m_slots[slot]));
+    }
+  } else {
+    for (uint32_t index = 0; index < env->m_globals.size(); index++) {
+      if (!env->m_globals[index].isEmpty()) {
+        rows.emplace_back(symbolName(env->m_globalNames->nameAt(index)),
+                          printValue(env->m_globals[index]));
+      }
+    }
+  }
+  formatScopeTable(ss, tableTitle("SCOPE " + std::to_string(depth), env),
+                   rows);
 
   // Recursively print enclosing environment
   if (env->enclosing != nullptr) {
+    const int totalWidth = 64;
     ss << std::string(totalWidth / 2, ' ') << "↓\n\n";
-    formatEnvironmentRecursive(ss, env->enclosing.get(), depth + 1);
+    formatEnvironmentRecursive(ss, env->enclosing, depth + 1);
   }
 }
 
@@ -125,3 +144,22 @@ std::string formatEnvironment(const Environment &env) {
   formatEnvironmentRecursive(ss, &env, 0);
   return ss.str();
 }
+
+std::string
+formatScope(size_t depth, const void *address,
+            const std::vector<std::pair<std::string, std::string>> &rows) {
+  std::stringstream ss;
+  formatScopeTable(ss, tableTitle("SCOPE " + std::to_string(depth), address),
+                   rows);
+  return ss.str();
+}
+
+std::string formatFrame(const ScopeLayout &layout, const Value *slots) {
+  std::vector<std::pair<std::string, std::string>> rows;
+  for (size_t slot = 0; slot < layout.names.size(); slot++) {
+    rows.emplace_back(symbolName(layout.names[slot]), printValue(slots[slot]));
+  }
+  std::stringstream ss;
+  formatScopeTable(ss, tableTitle("FRAME", slots), rows);
+  return ss.str();
+}
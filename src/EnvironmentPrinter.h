@@ -2,10 +2,15 @@
 #define ENVIRONMENT_PRINTER_H_
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <utility>
+#include <vector>
 
-// Forward declaration to avoid cyclic dependency
+// Forward declarations to avoid cyclic dependency
 class Environment;
+struct ScopeLayout;
+class Value;
 
 /**
  * @brief Generates a formatted string representation of the environment chain.
@@ -15,4 +20,24 @@ class Environment;
  */
 std::string formatEnvironment(const Environment& env);
 
+/**
+ * @brief Formats a single scope of already-printed name/value rows using the
+ * same table layout as formatEnvironment.
+ *
+ * @param depth The scope's distance from the innermost scope.
+ * @param address Identifies the scope in the header.
+ * @param rows Variable names paired with their printed values.
+ */
+std::string formatScope(size_t depth, const void *address,
+                        const std::vector<std::pair<std::string, std::string>> &rows);
+
+/**
+ * @brief Formats a call's stack frame, whose slots hold the locals no closure
+ * captures, using the same table layout as formatEnvironment.
+ *
+ * @param layout Names the frame's slots.
+ * @param slots The frame's values, one per name in layout.
+ */
+std::string formatFrame(const ScopeLayout &layout, const Value *slots);
+
 #endif // ENVIRONMENT_PRINTER_H_ 
\ No newline at end of file
@@ -2,14 +2,15 @@
 #define EXPR_H_
 #pragma once
 
+#include "Object.h"
+#include "Shape.hpp"
 #include "Token.h"
+#include "Value.h"
+#include <deque>
 #include <memory>
 #include <string>
-#include <variant>
 #include <vector>
 
-class LoxCallable;
-class LoxInstance;
 // Forward declaration
 class BinaryExpr;
 class LogicalExpr;
@@ -24,11 +25,23 @@ class SetExpr;
 class ThisExpr;
 class SuperExpr;
 
-// Define literal value type that can hold any kind of literal
-// todo: int is redundant
-using LiteralValue =
-    std::variant<std::string, int, double, bool, std::nullptr_t,
-                 std::shared_ptr<LoxCallable>, std::shared_ptr<LoxInstance>>;
+// Where the Resolver put a variable. Locals no nested function refers to
+// live in the running call's stack frame; the others live in an Environment
+// `depth` scopes out, where closures can keep them alive. Variables it didn't
+// find are globals, and `slot` is then their index in the GlobalTable.
+struct LocalSlot {
+  enum class Storage : uint8_t { GLOBAL, FRAME, ENVIRONMENT };
+
+  Storage storage = Storage::GLOBAL;
+  int depth = 0;
+  int slot = 0;
+
+  bool isGlobal() const { return storage == Storage::GLOBAL; }
+  bool isFrame() const { return storage == Storage::FRAME; }
+};
+
+// Most slots one stack frame may have
+inline constexpr int kFrameMax = 1 << 16;
 
 // Visitor pattern
 template <typename R> class ExprVisitor {
@@ -53,21 +66,38 @@ class Expr {
 public:
   virtual ~Expr() = default;
   virtual std::string accept(ExprVisitor<std::string> &visitor) const = 0;
-  virtual LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const = 0;
+  virtual Value accept(ExprVisitor<Value> &visitor) const = 0;
   virtual void accept(ExprVisitor<void> &visitor) const = 0;
 };
 
+// Operators decoded from their token once, when the node is built, so that
+// evaluating one is a switch on a small dense enum.
+enum class BinaryOp : uint8_t {
+  ADD,
+  SUBTRACT,
+  MULTIPLY,
+  DIVIDE,
+  GREATER,
+  GREATER_EQUAL,
+  LESS,
+  LESS_EQUAL,
+  EQUAL,
+  NOT_EQUAL,
+};
+enum class LogicalOp : uint8_t { AND, OR };
+enum class UnaryOp : uint8_t { NEGATE, NOT };
+
 // Binary expression
 class BinaryExpr : public Expr {
 public:
   BinaryExpr(const Expr &left, const Token &op, const Expr &right)
-      : left(left), op(op), right(right) {}
+      : left(left), op(op), right(right), opcode(decode(op.type)) {}
 
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitBinaryExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitBinaryExpr(*this);
   }
 
@@ -78,19 +108,47 @@ public:
   const Expr &left;
   const Token op;
   const Expr &right;
+  const BinaryOp opcode;
+
+private:
+  static BinaryOp decode(TokenType type) {
+    switch (type) {
+    case TokenType::PLUS:
+      return BinaryOp::ADD;
+    case TokenType::MINUS:
+      return BinaryOp::SUBTRACT;
+    case TokenType::STAR:
+      return BinaryOp::MULTIPLY;
+    case TokenType::SLASH:
+      return BinaryOp::DIVIDE;
+    case TokenType::GREATER:
+      return BinaryOp::GREATER;
+    case TokenType::GREATER_EQUAL:
+      return BinaryOp::GREATER_EQUAL;
+    case TokenType::LESS:
+      return BinaryOp::LESS;
+    case TokenType::LESS_EQUAL:
+      return BinaryOp::LESS_EQUAL;
+    case TokenType::EQUAL_EQUAL:
+      return BinaryOp::EQUAL;
+    default: // BANG_EQUAL, the only other operator the Parser builds
+      return BinaryOp::NOT_EQUAL;
+    }
+  }
 };
 
 // Binary expression
 class LogicalExpr : public Expr {
 public:
   LogicalExpr(const Expr &left, const Token &op, const Expr &right)
-      : left(left), op(op), right(right) {}
+      : left(left), op(op), right(right),
+        opcode(op.type == TokenType::OR ? LogicalOp::OR : LogicalOp::AND) {}
 
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitLogicalExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitLogicalExpr(*this);
   }
 
@@ -101,18 +159,21 @@ public:
   const Expr &left;
   const Token op;
   const Expr &right;
+  const LogicalOp opcode;
 };
 
 // Unary expression
 class UnaryExpr : public Expr {
 public:
-  UnaryExpr(const Token &op, const Expr &right) : op(op), right(right) {}
+  UnaryExpr(const Token &op, const Expr &right)
+      : op(op), right(right),
+        opcode(op.type == TokenType::MINUS ? UnaryOp::NEGATE : UnaryOp::NOT) {}
 
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitUnaryExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitUnaryExpr(*this);
   }
 
@@ -122,19 +183,38 @@ public:
 
   const Token op;
   const Expr &right;
+  const UnaryOp opcode;
+};
+
+// Owns the string objects of the string literals in an AST, for whatever
+// built it. They belong to no Heap and are created marked, so collectors
+// treat them as permanently reachable, and they stay put as more are added.
+// Kept apart from the nodes so that freeing a node never frees a string the
+// program still holds.
+class LiteralStrings {
+public:
+  Value add(std::string chars) {
+    ObjString &string = m_strings.emplace_back(std::move(chars));
+    string.isMarked = true;
+    return &string;
+  }
+
+private:
+  std::deque<ObjString> m_strings;
 };
 
 // Literal expression
 class LiteralExpr : public Expr {
 public:
-  LiteralExpr(const LiteralValue &value) : value(value) {}
+  // A string's object must outlive the node (see LiteralStrings)
+  LiteralExpr(Value value) : value(value) {}
   LiteralExpr() : value(nullptr) {} // for nil
 
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitLiteralExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitLiteralExpr(*this);
   }
 
@@ -142,7 +222,7 @@ public:
     visitor.visitLiteralExpr(*this);
   }
 
-  const LiteralValue value;
+  const Value value;
 };
 
 // Grouping expression
@@ -154,7 +234,7 @@ public:
     return visitor.visitGroupingExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitGroupingExpr(*this);
   }
 
@@ -174,7 +254,7 @@ public:
     return visitor.visitVariableExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitVariableExpr(*this);
   }
 
@@ -183,6 +263,7 @@ public:
   }
 
   const Token name;
+  mutable LocalSlot local; // Set by the Resolver
 };
 
 class AssignExpr : public Expr {
@@ -193,7 +274,7 @@ public:
     return visitor.visitAssignExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitAssignExpr(*this);
   }
 
@@ -203,6 +284,7 @@ public:
 
   const Token name;
   const Expr &value;
+  mutable LocalSlot local; // Set by the Resolver
 };
 
 class CallExpr : public Expr {
@@ -215,7 +297,7 @@ public:
     return visitor.visitCallExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitCallExpr(*this);
   }
 
@@ -237,7 +319,7 @@ public:
     return visitor.visitGetExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitGetExpr(*this);
   }
   void accept(ExprVisitor<void> &visitor) const override {
@@ -246,6 +328,7 @@ public:
 
   const Expr &object;
   const Token name;
+  mutable PropertyCache cache; // Filled in by the Interpreter
 };
 
 class SetExpr : public Expr {
@@ -258,7 +341,7 @@ public:
     return visitor.visitSetExpr(*this);
   }
 
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitSetExpr(*this);
   }
 
@@ -269,6 +352,7 @@ public:
   const Expr &object;
   const Token name;
   const Expr &value;
+  mutable PropertyCache cache; // Filled in by the Interpreter
 };
 
 class ThisExpr : public Expr {
@@ -277,13 +361,14 @@ public:
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitThisExpr(*this);
   }
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitThisExpr(*this);
   }
   void accept(ExprVisitor<void> &visitor) const override {
     visitor.visitThisExpr(*this);
   }
   const Token keyword;
+  mutable LocalSlot local; // Set by the Resolver
 };
 
 class SuperExpr : public Expr {
@@ -293,7 +378,7 @@ public:
   std::string accept(ExprVisitor<std::string> &visitor) const override {
     return visitor.visitSuperExpr(*this);
   }
-  LiteralValue accept(ExprVisitor<LiteralValue> &visitor) const override {
+  Value accept(ExprVisitor<Value> &visitor) const override {
     return visitor.visitSuperExpr(*this);
   }
   void accept(ExprVisitor<void> &visitor) const override {
@@ -301,6 +386,8 @@ public:
   }
   const Token keyword;
   const Token method;
+  mutable LocalSlot local;    // Set by the Resolver
+  mutable LocalSlot receiver; // `this`, set by the Resolver
 };
 
 #endif // EXPR_H_
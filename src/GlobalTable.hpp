@@ -0,0 +1,38 @@
+#ifndef GLOBAL_TABLE_H_
+#define GLOBAL_TABLE_H_
+#pragma once
+
+#include "Symbol.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Dense numbering of a program's global variable names.
+ *
+ * The Resolver gives each global name an index the first time it sees it,
+ * declared or referenced, and binds every global reference site to that
+ * index. The Interpreter keeps global values in an array indexed the same
+ * way, so a global access is an index rather than a hash lookup.
+ */
+class GlobalTable {
+public:
+  // Index of `name`, assigning the next one if it has none yet
+  uint32_t indexOf(Symbol name) {
+    auto [it, inserted] =
+        m_indices.emplace(name, static_cast<uint32_t>(m_names.size()));
+    if (inserted) {
+      m_names.push_back(name);
+    }
+    return it->second;
+  }
+
+  Symbol nameAt(uint32_t index) const { return m_names[index]; }
+  size_t size() const { return m_names.size(); }
+
+private:
+  std::unordered_map<Symbol, uint32_t> m_indices;
+  std::vector<Symbol> m_names;
+};
+
+#endif // GLOBAL_TABLE_H_
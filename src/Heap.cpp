@@ -0,0 +1,74 @@
+#include "Heap.h"
+#include <algorithm>
+
+Heap::~Heap() {
+  Obj *obj = m_objects;
+  while (obj != nullptr) {
+    Obj *next = obj->next;
+    delete obj;
+    obj = next;
+  }
+}
+
+ObjString *Heap::intern(std::string_view chars) {
+  auto it = m_strings.find(chars);
+  if (it != m_strings.end())
+    return it->second;
+  return intern(std::string(chars));
+}
+
+ObjString *Heap::intern(std::string &&chars) {
+  auto it = m_strings.find(chars);
+  if (it != m_strings.end())
+    return it->second;
+  ObjString *string = track(new ObjString(std::move(chars)));
+  m_strings.emplace(string->chars, string);
+  return string;
+}
+
+void Heap::markObject(Obj *obj) {
+  if (obj == nullptr || obj->isMarked)
+    return;
+  obj->isMarked = true;
+  m_grayStack.push_back(obj);
+}
+
+void Heap::collectGarbage() {
+  m_roots.markRoots(*this);
+  traceReferences();
+
+  for (auto it = m_strings.begin(); it != m_strings.end();) {
+    if (!it->second->isMarked)
+      it = m_strings.erase(it);
+    else
+      ++it;
+  }
+
+  sweep();
+  m_nextGC = std::max(
+      static_cast<size_t>(m_bytesAllocated * m_config.growthFactor),
+      m_config.minThreshold);
+}
+
+void Heap::traceReferences() {
+  while (!m_grayStack.empty()) {
+    Obj *obj = m_grayStack.back();
+    m_grayStack.pop_back();
+    obj->trace(*this);
+  }
+}
+
+void Heap::sweep() {
+  Obj **link = &m_objects;
+  while (*link != nullptr) {
+    Obj *obj = *link;
+    if (obj->isMarked) {
+      obj->isMarked = false;
+      link = &obj->next;
+    } else {
+      *link = obj->next;
+      m_bytesAllocated -= obj->heapSize;
+      delete obj;
+    }
+  }
+}
@@ -0,0 +1,111 @@
+#ifndef HEAP_H_
+#define HEAP_H_
+#pragma once
+
+#include "Object.h"
+#include "Value.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Tuning for when the collector runs. After each collection the next one is
+// scheduled once the live heap has grown by `growthFactor`, but never below
+// `minThreshold` bytes.
+struct HeapConfig {
+  size_t minThreshold = 1024 * 1024;
+  double growthFactor = 2;
+};
+
+/**
+ * Owner of every runtime object, with a precise mark-sweep collector.
+ *
+ * The heap does not know where its roots live; whoever drives execution
+ * implements RootSource and marks the values it holds when asked.
+ */
+class Heap {
+public:
+  class RootSource {
+  public:
+    virtual ~RootSource() = default;
+    virtual void markRoots(Heap &heap) = 0;
+  };
+
+  explicit Heap(RootSource &roots, HeapConfig config = {})
+      : m_roots(roots), m_config(config), m_nextGC(config.minThreshold) {}
+  ~Heap();
+
+  Heap(const Heap &) = delete;
+  Heap &operator=(const Heap &) = delete;
+
+  // Allocates an object, possibly collecting first. Anything the caller holds
+  // only in C++ locals must be reachable from the roots before calling this.
+  template <typename T, typename... Args> T *allocate(Args &&...args) {
+    return track(new T(std::forward<Args>(args)...));
+  }
+
+  // Charges `obj` for storage it gained (or lost) since it was last charged.
+  // Never collects; the next check of wantsCollection() sees the change.
+  void resized(Obj *obj) {
+    size_t size = obj->size();
+    m_bytesAllocated = m_bytesAllocated - obj->heapSize + size;
+    obj->heapSize = size;
+  }
+
+  // Returns the unique string object with these characters.
+  ObjString *intern(std::string_view chars);
+  ObjString *intern(std::string &&chars);
+
+  void markValue(Value value) {
+    if (value.isObj())
+      markObject(value.asObj());
+  }
+  void markObject(Obj *obj);
+
+  void collectGarbage();
+
+  // Whether enough has been allocated since the last collection that a
+  // collector driven from outside (see Interpreter::execute) should run one.
+  bool wantsCollection() const {
+#ifdef LOX_STRESS_GC
+    return true;
+#else
+    return m_bytesAllocated > m_nextGC;
+#endif
+  }
+
+  // While paused, allocation never triggers a collection. Used by the
+  // compiler, whose half-built functions are not reachable from any root.
+  void pause() { m_pauseDepth++; }
+  void resume() { m_pauseDepth--; }
+
+private:
+  template <typename T> T *track(T *obj) {
+    obj->heapSize = obj->size();
+    m_bytesAllocated += obj->heapSize;
+    if (m_pauseDepth == 0 && wantsCollection()) {
+      // The new object is not linked yet, so it survives this collection.
+      collectGarbage();
+    }
+    obj->next = m_objects;
+    m_objects = obj;
+    return obj;
+  }
+
+  void traceReferences();
+  void sweep();
+
+  RootSource &m_roots;
+  const HeapConfig m_config;
+  Obj *m_objects = nullptr;
+  std::vector<Obj *> m_grayStack;
+  // Weak: entries whose string is unreachable are dropped before sweeping.
+  std::unordered_map<std::string_view, ObjString *> m_strings;
+  size_t m_bytesAllocated = 0;
+  size_t m_nextGC;
+  int m_pauseDepth = 0;
+};
+
+#endif // HEAP_H_
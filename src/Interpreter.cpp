@@ -1,23 +1,49 @@
 #include "Interpreter.h"
-#include "AstPrinter.hpp"
 #include "Expr.hpp"
 #include "LoxClass.h"
 #include "LoxFunction.h"
+#include "LoxInstance.h"
 #include "NativeFunctions.hpp"
 #include "Stmt.hpp"
 #include <iostream>
+#include <utility>
 
-Interpreter::Interpreter() {
-  m_globals = std::make_shared<Environment>();
+Interpreter::Interpreter(GlobalTable &globals, HeapConfig heapConfig)
+    : m_heap(*this, heapConfig), m_globalTable(globals) {
+  // Values held in C++ locals are only rooted where execute() checks for a
+  // collection, so allocation itself must never collect.
+  m_heap.pause();
+  m_stack.reserve(kStackMax + kFrameMax);
+
+  m_globals = m_heap.allocate<Environment>(m_globalTable);
   m_envptr = m_globals;
 
   // Register native functions in the global environment
-  for (const auto &[name, function] : createNativeFunctions()) {
-    m_globals->define(name, function);
+  for (const auto &[name, function] : createNativeFunctions(m_heap)) {
+    m_globals->defineGlobal(m_heap, m_globalTable.indexOf(internSymbol(name)),
+                            function);
   }
 }
 
-Environment *Interpreter::getEnvironment() const { return m_envptr.get(); }
+Environment *Interpreter::getEnvironment() const { return m_envptr; }
+
+std::string Interpreter::environmentToString() const {
+  std::string frame;
+  if (m_frameSlots) {
+    frame = formatFrame(*m_frameSlots, m_frame) + std::string(32, ' ') +
+            "↓\n\n";
+  }
+  return frame + m_envptr->toString();
+}
+
+void Interpreter::markRoots(Heap &heap) {
+  heap.markObject(m_globals);
+  heap.markObject(m_envptr);
+  for (Value value : m_stack) {
+    heap.markValue(value);
+  }
+  heap.markValue(m_returnValue);
+}
 
 void Interpreter::interpret(const std::vector<Stmt *> &statements) {
   try {
@@ -29,196 +55,230 @@ void Interpreter::interpret(const std::vector<Stmt *> &statements) {
   }
 }
 
-LiteralValue Interpreter::visitLiteralExpr(const LiteralExpr &expr) {
+Value Interpreter::visitLiteralExpr(const LiteralExpr &expr) {
   return expr.value;
 }
 
-LiteralValue Interpreter::visitGroupingExpr(const GroupingExpr &expr) {
+Value Interpreter::visitGroupingExpr(const GroupingExpr &expr) {
   return evaluate(expr.expr);
 }
 
-LiteralValue Interpreter::visitUnaryExpr(const UnaryExpr &expr) {
-  LiteralValue right = evaluate(expr.right);
+Value Interpreter::visitUnaryExpr(const UnaryExpr &expr) {
+  Value right = evaluate(expr.right);
 
-  if (expr.op.lexeme == "-") {
+  switch (expr.opcode) {
+  case UnaryOp::NEGATE:
     checkNumberOperand(expr.op, right);
-    if (std::holds_alternative<double>(right)) {
-      return -std::get<double>(right);
-    }
-    return -std::get<int>(right);
-  } else if (expr.op.lexeme == "!") {
-    return !isTruthy(right);
+    return -right.asNumber();
+  case UnaryOp::NOT:
+    return right.isFalsey();
   }
 
   // Unreachable
   throw RuntimeError(expr.op, "Invalid unary operator");
 }
 
-LiteralValue Interpreter::visitVariableExpr(const VariableExpr &expr) {
-  return lookUpVariable(expr.name, expr);
+Value Interpreter::visitVariableExpr(const VariableExpr &expr) {
+  return lookUpVariable(expr.name, expr.local);
 }
 
-LiteralValue Interpreter::lookUpVariable(const Token &name, const Expr &expr) {
-  // Check if the expression exists in the locals map
-  auto it = m_locals.find(&expr);
-  if (it != m_locals.end()) {
-    int distance = it->second;
-    return m_envptr->getAt(distance, name);
-  } else {
-    // If not found in locals, assume it's a global variable.
-    // The Resolver should have caught undefined variables already.
-    return m_globals->get(name);
+Value Interpreter::lookUpVariable(const Token &name, LocalSlot local) {
+  switch (local.storage) {
+  case LocalSlot::Storage::FRAME:
+    return m_frame[local.slot];
+  case LocalSlot::Storage::ENVIRONMENT:
+    return m_envptr->getAt(local);
+  case LocalSlot::Storage::GLOBAL:
+    break;
   }
+  return m_globals->getGlobal(name, local.slot);
 }
 
 void Interpreter::visitWhileStmt(const WhileStmt &stmt) {
-  try {
-    while (isTruthy(evaluate(stmt.condition))) {
-      try {
-        execute(stmt.body);
-      } catch (const ContinueException &) {
-        if (stmt.increment)
-          execute(*stmt.increment);
-        continue;
-      }
-      if (stmt.increment)
-        execute(*stmt.increment);
+  while (!evaluate(stmt.condition).isFalsey()) {
+    Completion completion = execute(stmt.body);
+    if (completion == Completion::RETURN) {
+      return; // Leave it for the enclosing call
+    }
+    m_completion = Completion::NORMAL;
+    if (completion == Completion::BREAK) {
+      break;
     }
-  } catch (const BreakException &) {
-    // Break encountered, exit the loop
+    if (stmt.increment)
+      execute(*stmt.increment);
   }
 }
 
-LiteralValue Interpreter::visitBinaryExpr(const BinaryExpr &expr) {
-  LiteralValue left = evaluate(expr.left);
-  LiteralValue right = evaluate(expr.right);
+Value Interpreter::visitBinaryExpr(const BinaryExpr &expr) {
+  Roots roots(*this);
+  Value left = roots.push(evaluate(expr.left));
+  Value right = evaluate(expr.right);
 
-  if (expr.op.lexeme == "+") {
-    if (std::holds_alternative<std::string>(left) &&
-        std::holds_alternative<std::string>(right)) {
-      return std::get<std::string>(left) + std::get<std::string>(right);
+  switch (expr.opcode) {
+  case BinaryOp::ADD:
+    if (isObjType(left, ObjType::STRING) && isObjType(right, ObjType::STRING)) {
+      return m_heap.intern(static_cast<ObjString *>(left.asObj())->chars +
+                           static_cast<ObjString *>(right.asObj())->chars);
     }
-    if (isNumber(left) && isNumber(right)) {
-      return getNumberValue(left) + getNumberValue(right);
+    if (left.isNumber() && right.isNumber()) {
+      return left.asNumber() + right.asNumber();
     }
     throw RuntimeError(expr.op, "Operands must be two numbers or two strings.");
-  } else if (expr.op.lexeme == "-") {
+  case BinaryOp::SUBTRACT:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) - getNumberValue(right);
-  } else if (expr.op.lexeme == "*") {
+    return left.asNumber() - right.asNumber();
+  case BinaryOp::MULTIPLY:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) * getNumberValue(right);
-  } else if (expr.op.lexeme == "/") {
+    return left.asNumber() * right.asNumber();
+  case BinaryOp::DIVIDE: {
     checkNumberOperand(expr.op, left, right);
-    double rightNum = getNumberValue(right);
+    double rightNum = right.asNumber();
     if (rightNum == 0) {
       throw RuntimeError(expr.op, "Division by zero.");
     }
-    return getNumberValue(left) / rightNum;
-  } else if (expr.op.lexeme == ">") {
+    return left.asNumber() / rightNum;
+  }
+  case BinaryOp::GREATER:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) > getNumberValue(right);
-  } else if (expr.op.lexeme == ">=") {
+    return left.asNumber() > right.asNumber();
+  case BinaryOp::GREATER_EQUAL:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) >= getNumberValue(right);
-  } else if (expr.op.lexeme == "<") {
+    return left.asNumber() >= right.asNumber();
+  case BinaryOp::LESS:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) < getNumberValue(right);
-  } else if (expr.op.lexeme == "<=") {
+    return left.asNumber() < right.asNumber();
+  case BinaryOp::LESS_EQUAL:
     checkNumberOperand(expr.op, left, right);
-    return getNumberValue(left) <= getNumberValue(right);
-  } else if (expr.op.lexeme == "==") {
-    return isEqual(left, right);
-  } else if (expr.op.lexeme == "!=") {
-    return !isEqual(left, right);
+    return left.asNumber() <= right.asNumber();
+  case BinaryOp::EQUAL:
+    return valuesEqual(left, right);
+  case BinaryOp::NOT_EQUAL:
+    return !valuesEqual(left, right);
   }
 
   // Unreachable
   throw RuntimeError(expr.op, "Invalid binary operator");
 }
 
-LiteralValue Interpreter::visitCallExpr(const CallExpr &expr) {
-  LiteralValue callee = evaluate(expr.callee);
+Value Interpreter::visitCallExpr(const CallExpr &expr) {
+  // The callee stays rooted for the whole call: a temporary such as a bound
+  // method is referenced by nothing else while its body runs.
+  Roots roots(*this);
 
-  std::vector<LiteralValue> arguments;
+  // `object.method(...)` calls the method with `object` as its receiver
+  // directly instead of creating a bound method just to call it once.
+  if (auto *get = dynamic_cast<const GetExpr *>(&expr.callee)) {
+    Value object = roots.push(evaluate(get->object));
+    if (!isInstance(object)) {
+      throw RuntimeError(get->name, "Only instances have properties.");
+    }
+    Value field;
+    LoxFunction *method =
+        asInstance(object)->getMethodOrField(get->name, get->cache, field);
+    if (method) {
+      std::span<const Value> arguments = evaluateArguments(expr, roots);
+      checkArity(expr, method->arity(), arguments.size());
+      CallDepth depth(*this, expr);
+      return method->invoke(*this, asInstance(object), arguments);
+    }
+    return call(expr, roots.push(field), roots);
+  }
+
+  return call(expr, roots.push(evaluate(expr.callee)), roots);
+}
+
+// Evaluates the arguments of `expr` onto the stack, where they stay rooted
+// by `roots`.
+std::span<const Value> Interpreter::evaluateArguments(const CallExpr &expr,
+                                                      Roots &roots) {
+  if (m_stack.size() + expr.arguments.size() > kStackMax) {
+    throw RuntimeError(expr.paren, "Stack overflow.");
+  }
+  size_t base = m_stack.size();
   for (const Expr *argument : expr.arguments) {
-    arguments.push_back(evaluate(*argument));
+    roots.push(evaluate(*argument));
   }
+  return {m_stack.data() + base, expr.arguments.size()};
+}
+
+Value Interpreter::call(const CallExpr &expr, Value callee, Roots &roots) {
+  std::span<const Value> arguments = evaluateArguments(expr, roots);
 
-  if (!std::holds_alternative<std::shared_ptr<LoxCallable>>(callee)) {
+  if (!isCallable(callee)) {
     throw RuntimeError(expr.paren, "Can only call functions and classes.");
   }
 
-  auto function = std::get<std::shared_ptr<LoxCallable>>(callee);
-  if (arguments.size() != function->arity()) {
-    throw RuntimeError(expr.paren, "Expected " +
-                                       std::to_string(function->arity()) +
+  LoxCallable *function = asCallable(callee);
+  checkArity(expr, function->arity(), arguments.size());
+  CallDepth depth(*this, expr);
+  return function->call(*this, arguments);
+}
+
+void Interpreter::checkArity(const CallExpr &expr, int arity,
+                             size_t argumentCount) {
+  if (argumentCount != arity) {
+    throw RuntimeError(expr.paren, "Expected " + std::to_string(arity) +
                                        " arguments but got " +
-                                       std::to_string(arguments.size()) + ".");
+                                       std::to_string(argumentCount) + ".");
   }
-
-  return function->call(*this, arguments);
 }
 
-LiteralValue Interpreter::visitGetExpr(const GetExpr &expr) {
-  LiteralValue object = evaluate(expr.object);
-  if (std::holds_alternative<std::shared_ptr<LoxInstance>>(object)) {
-    auto instance = std::get<std::shared_ptr<LoxInstance>>(object);
-    return instance->get(expr.name.lexeme);
+Value Interpreter::visitGetExpr(const GetExpr &expr) {
+  Value object = evaluate(expr.object);
+  if (isInstance(object)) {
+    return asInstance(object)->get(m_heap, expr.name, expr.cache);
   }
   throw RuntimeError(expr.name, "Only instances have properties.");
 }
 
-LiteralValue Interpreter::visitSetExpr(const SetExpr &expr) {
-  LiteralValue object = evaluate(expr.object);
-  if (!std::holds_alternative<std::shared_ptr<LoxInstance>>(object)) {
+Value Interpreter::visitSetExpr(const SetExpr &expr) {
+  Roots roots(*this);
+  Value object = roots.push(evaluate(expr.object));
+  if (!isInstance(object)) {
     throw RuntimeError(expr.name, "Only instances have fields.");
   }
 
-  LiteralValue value = evaluate(expr.value);
-  auto instance = std::get<std::shared_ptr<LoxInstance>>(object);
-  instance->set(expr.name.lexeme, value);
+  Value value = evaluate(expr.value);
+  asInstance(object)->set(m_heap, expr.name.symbol, value, expr.cache);
   return value;
 }
 
-LiteralValue Interpreter::visitThisExpr(const ThisExpr &expr) {
-  return lookUpVariable(expr.keyword, expr);
+Value Interpreter::visitThisExpr(const ThisExpr &expr) {
+  return lookUpVariable(expr.keyword, expr.local);
 }
 
-LiteralValue Interpreter::visitSuperExpr(const SuperExpr &expr) {
-  auto it = m_locals.find(&expr);
-  if (it == m_locals.end()) {
+Value Interpreter::visitSuperExpr(const SuperExpr &expr) {
+  if (expr.local.isGlobal()) {
     throw RuntimeError(expr.keyword, "Undefined 'super' binding.");
   }
 
-  int distance = it->second;
-  LiteralValue superclassValue = m_envptr->getAt(distance, expr.keyword);
-  auto callable = std::get<std::shared_ptr<LoxCallable>>(superclassValue);
-  auto superclass = std::dynamic_pointer_cast<LoxClass>(callable);
+  // `super` lives in its own scope just outside the method's scope
+  auto *superclass =
+      dynamic_cast<LoxClass *>(m_envptr->getAt(expr.local).asObj());
   if (!superclass) {
     throw RuntimeError(expr.keyword, "Superclass must be a class.");
   }
 
-  Token thisToken(TokenType::THIS, "this", expr.keyword.line);
-  LiteralValue objectValue = m_envptr->getAt(distance - 1, thisToken);
-  auto object = std::get<std::shared_ptr<LoxInstance>>(objectValue);
+  LoxInstance *object =
+      asInstance(lookUpVariable(expr.keyword, expr.receiver));
 
-  auto method = superclass->findMethod(expr.method.lexeme);
+  LoxFunction *method = superclass->findMethod(expr.method.symbol);
   if (!method) {
     throw RuntimeError(expr.method,
-                       "Undefined property '" + expr.method.lexeme + "'.");
+                       "Undefined property '" +
+                           std::string(expr.method.lexeme) + "'.");
   }
 
-  return method->bind(object);
+  return method->bind(m_heap, object);
 }
 
-LiteralValue Interpreter::visitLogicalExpr(const LogicalExpr &expr) {
-  LiteralValue left = evaluate(expr.left);
-  if (expr.op.lexeme == "or") {
-    if (isTruthy(left))
+Value Interpreter::visitLogicalExpr(const LogicalExpr &expr) {
+  Value left = evaluate(expr.left);
+  if (expr.opcode == LogicalOp::OR) {
+    if (!left.isFalsey())
       return left;
   } else {
-    if (!isTruthy(left))
+    if (left.isFalsey())
       return left;
   }
   return evaluate(expr.right);
@@ -228,55 +288,58 @@ void Interpreter::visitExpressionStmt(const ExpressionStmt &stmt) {
   evaluate(stmt.expression);
 }
 void Interpreter::visitClassStmt(const ClassStmt &stmt) {
-  std::shared_ptr<LoxClass> superclass;
+  LoxClass *superclass = nullptr;
 
   if (stmt.superclass) {
-    LiteralValue superclassValue = evaluate(*stmt.superclass);
-    if (!std::holds_alternative<std::shared_ptr<LoxCallable>>(
-            superclassValue)) {
+    Value superclassValue = evaluate(*stmt.superclass);
+    if (!isCallable(superclassValue)) {
       throw RuntimeError(stmt.superclass->name, "Superclass must be a class.");
     }
 
-    auto callable = std::get<std::shared_ptr<LoxCallable>>(superclassValue);
-    superclass = std::dynamic_pointer_cast<LoxClass>(callable);
+    superclass = dynamic_cast<LoxClass *>(asCallable(superclassValue));
     if (!superclass) {
       throw RuntimeError(stmt.superclass->name, "Superclass must be a class.");
     }
   }
 
-  m_envptr->define(stmt.name.lexeme, nullptr);
-
   auto previousEnv = m_envptr;
   if (stmt.superclass) {
-    m_envptr = std::make_shared<Environment>(m_envptr);
-    m_envptr->define("super", superclass);
+    m_envptr = m_heap.allocate<Environment>(m_envptr, kSuperScope);
+    m_envptr->define(superclass);
   }
 
-  std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods;
+  // Inherited methods are copied down, so that a subclass's own ones
+  // override them and lookups cost the same at any depth.
+  std::unordered_map<Symbol, LoxFunction *> methods;
+  if (superclass) {
+    methods = superclass->methods();
+  }
   for (const auto &method : stmt.methods) {
-    std::shared_ptr<LoxFunction> function = std::make_shared<LoxFunction>(
-        method, m_envptr, method->name.lexeme == "init");
-    methods[method->name.lexeme] = function;
+    LoxFunction *function = m_heap.allocate<LoxFunction>(
+        method, m_envptr, method->layout, method->name.lexeme == "init");
+    methods[method->name.symbol] = function;
   }
 
-  std::shared_ptr<LoxClass> klass = std::make_shared<LoxClass>(
-      stmt.name.lexeme, superclass, std::move(methods));
+  LoxClass *klass = m_heap.allocate<LoxClass>(
+      std::string(stmt.name.lexeme), std::move(methods));
 
   if (stmt.superclass) {
     m_envptr = previousEnv;
   }
 
-  m_envptr->assign(stmt.name, klass);
+  // Methods only look the class up when they run, so the name can be bound
+  // once the class is complete.
+  declare(stmt.local, klass);
 }
 
 void Interpreter::visitFunctionStmt(const FunctionStmt &stmt) {
-  std::shared_ptr<LoxFunction> function =
-      std::make_shared<LoxFunction>(&stmt, m_envptr, false);
-  m_envptr->define(stmt.name.lexeme, function);
+  LoxFunction *function =
+      m_heap.allocate<LoxFunction>(&stmt, m_envptr, stmt.layout, false);
+  declare(stmt.local, function);
 }
 
 void Interpreter::visitIfStmt(const IfStmt &stmt) {
-  if (isTruthy(evaluate(stmt.condition))) {
+  if (!evaluate(stmt.condition).isFalsey()) {
     execute(stmt.thenBranch);
   } else if (stmt.elseBranch) {
     execute(*stmt.elseBranch);
@@ -284,47 +347,65 @@ void Interpreter::visitIfStmt(const IfStmt &stmt) {
 }
 
 void Interpreter::visitPrintStmt(const PrintStmt &stmt) {
-  LiteralValue value = evaluate(stmt.expression);
-  AstPrinter printer;
-  std::cout << printer.print(LiteralExpr(value)) << std::endl;
+  Value value = evaluate(stmt.expression);
+  std::cout << valueToString(value) << std::endl;
 }
 
 void Interpreter::visitVarStmt(const VarStmt &stmt) {
-  LiteralValue value = nullptr; // Set to nil if it isn't explicitly initialized
+  Value value = nullptr; // Set to nil if it isn't explicitly initialized
   if (stmt.initializer) {
     value = evaluate(*stmt.initializer);
   }
-  m_envptr->define(stmt.name.lexeme, value);
-}
-
-LiteralValue Interpreter::visitAssignExpr(const AssignExpr &expr) {
-  LiteralValue value = evaluate(expr.value);
-
-  auto it = m_locals.find(&expr);
-  if (it != m_locals.end()) {
-    int distance = it->second;
-    m_envptr->assignAt(distance, expr.name, value);
-  } else {
-    m_globals->assign(expr.name, value);
+  declare(stmt.local, value);
+}
+
+Value Interpreter::visitAssignExpr(const AssignExpr &expr) {
+  Value value = evaluate(expr.value);
+
+  switch (expr.local.storage) {
+  case LocalSlot::Storage::FRAME:
+    m_frame[expr.local.slot] = value;
+    break;
+  case LocalSlot::Storage::ENVIRONMENT:
+    m_envptr->assignAt(expr.local, value);
+    break;
+  case LocalSlot::Storage::GLOBAL:
+    m_globals->assignGlobal(expr.name, expr.local.slot, value);
+    break;
   }
 
   return value;
 }
 
 void Interpreter::visitBlockStmt(const BlockStmt &stmt) {
-  auto env = std::make_shared<Environment>(m_envptr);
-  executeBlock(stmt.statements, env);
+  Frame frame(*this, stmt.frame);
+  if (!stmt.hasScope) {
+    for (const Stmt *statement : stmt.statements) {
+      if (execute(*statement) != Completion::NORMAL) {
+        return; // m_completion still says why
+      }
+    }
+    return;
+  }
+  executeBlock(stmt.statements,
+               m_heap.allocate<Environment>(m_envptr, stmt.layout));
 }
 
-void Interpreter::executeBlock(const std::vector<Stmt *> &statements,
-                               std::shared_ptr<Environment> env) {
+Completion Interpreter::executeBlock(const std::vector<Stmt *> &statements,
+                                     Environment *env) {
   // error prone
-  auto previous = m_envptr;
+  Roots roots(*this);
+  Environment *previous = m_envptr;
+  roots.push(previous);
   m_envptr = env;
 
+  Completion completion = Completion::NORMAL;
   try {
     for (const Stmt *statement : statements) {
-      execute(*statement);
+      completion = execute(*statement);
+      if (completion != Completion::NORMAL) {
+        break;
+      }
     }
   } catch (...) {
     m_envptr = previous;
@@ -332,81 +413,67 @@ void Interpreter::executeBlock(const std::vector<Stmt *> &statements,
   }
 
   m_envptr = previous;
+  return completion;
+}
+
+Value Interpreter::takeReturnValue() {
+  m_completion = Completion::NORMAL;
+  return std::exchange(m_returnValue, nullptr);
 }
 
 void Interpreter::visitBreakStmt(const BreakStmt &stmt) {
-  throw BreakException();
+  m_completion = Completion::BREAK;
 }
 
 void Interpreter::visitContinueStmt(const ContinueStmt &stmt) {
-  throw ContinueException();
+  m_completion = Completion::CONTINUE;
 }
 
 void Interpreter::visitReturnStmt(const ReturnStmt &stmt) {
-  LiteralValue value = nullptr;
+  Value value = nullptr;
   if (stmt.value) {
     value = evaluate(*stmt.value);
   }
-  throw ReturnException(value);
+  m_returnValue = std::move(value);
+  m_completion = Completion::RETURN;
 }
 
-LiteralValue Interpreter::evaluate(const Expr &expr) {
+Value Interpreter::evaluate(const Expr &expr) {
   return expr.accept(*this);
 }
 
-void Interpreter::execute(const Stmt &stmt) { stmt.accept(*this); }
-
-void Interpreter::resolve(const Expr &expr, int depth) {
-  m_locals[&expr] = depth;
-}
-
-bool Interpreter::isTruthy(const LiteralValue &value) {
-  if (std::holds_alternative<std::nullptr_t>(value))
-    return false;
-  if (std::holds_alternative<bool>(value))
-    return std::get<bool>(value);
-  if (std::holds_alternative<int>(value))
-    return std::get<int>(value) != 0;
-  if (std::holds_alternative<double>(value))
-    return std::get<double>(value) != 0;
-  return true;
-}
-
-bool Interpreter::isEqual(const LiteralValue &a, const LiteralValue &b) {
-  // Compare numbers regardless of their exact type (int or double)
-  if (isNumber(a) && isNumber(b)) {
-    return getNumberValue(a) == getNumberValue(b);
+Completion Interpreter::execute(const Stmt &stmt) {
+  if (m_heap.wantsCollection()) {
+    m_heap.collectGarbage();
   }
-  return a == b;
-}
-
-bool Interpreter::isNumber(const LiteralValue &value) {
-  return std::holds_alternative<double>(value) ||
-         std::holds_alternative<int>(value);
-}
-
-double Interpreter::getNumberValue(const LiteralValue &value) {
-  // Only call this function if isNumber(value) returns true
-  if (std::holds_alternative<double>(value)) {
-    return std::get<double>(value);
-  }
-  if (std::holds_alternative<int>(value)) {
-    return static_cast<double>(std::get<int>(value));
+  stmt.accept(*this);
+  return m_completion;
+}
+
+void Interpreter::declare(LocalSlot local, Value value) {
+  switch (local.storage) {
+  case LocalSlot::Storage::FRAME:
+    m_frame[local.slot] = value;
+    break;
+  case LocalSlot::Storage::ENVIRONMENT:
+    // Captured variables are declared in slot order
+    m_envptr->define(value);
+    break;
+  case LocalSlot::Storage::GLOBAL:
+    m_globals->defineGlobal(m_heap, local.slot, value);
+    break;
   }
-  // Unreachable
-  throw std::runtime_error("Value is not a number.");
 }
 
-void Interpreter::checkNumberOperand(const Token &op,
-                                     const LiteralValue &operand) {
-  if (!isNumber(operand)) {
+void Interpreter::checkNumberOperand(const Token &op, Value operand) {
+  if (!operand.isNumber()) {
     throw RuntimeError(op, "Operand must be a number.");
   }
 }
 
-void Interpreter::checkNumberOperand(const Token &op, const LiteralValue &left,
-                                     const LiteralValue &right) {
-  if (!isNumber(left) || !isNumber(right)) {
+void Interpreter::checkNumberOperand(const Token &op, Value left,
+                                     Value right) {
+  if (!left.isNumber() || !right.isNumber()) {
     throw RuntimeError(op, "Operands must be numbers.");
   }
 }
@@ -3,63 +3,46 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <vector>
 #include <unordered_map>
 #include "Expr.hpp"
 #include "Stmt.hpp"
 #include "Environment.hpp"
+#include "Heap.h"
+#include "error.h"
 
-// Custom exception for handling break statements
-class BreakException : public std::exception {
-public:
-    [[nodiscard]] const char* what() const noexcept override {
-        return "Break statement encountered";
-    }
-};
-
-class ReturnException : public std::exception {
-public:
-    explicit ReturnException(LiteralValue value) : m_value(std::move(value)) {}
-
-    [[nodiscard]] const char* what() const noexcept override {
-        return "Return statement encountered";
-    }
-
-    [[nodiscard]] LiteralValue getValue() const {
-        return m_value;
-    }
-private:
-    LiteralValue m_value;
-};
-
-// Custom exception for handling continue statements
-class ContinueException : public std::exception {
-public:
-    [[nodiscard]] const char* what() const noexcept override {
-        return "Continue statement encountered";
-    }
-};
+// How a statement finished executing. Anything other than NORMAL makes the
+// enclosing statements stop early until a loop or function call consumes it.
+enum class Completion { NORMAL, BREAK, CONTINUE, RETURN };
 
-class Interpreter : public ExprVisitor<LiteralValue>, public StmtVisitor<void> {
-friend class Resolver;
+class Interpreter : public ExprVisitor<Value>, public StmtVisitor<void>,
+                    public Heap::RootSource {
+friend class ClosureCompiler;
 public:
-    Interpreter();
+    // `globals` numbers the program's globals; it must be the table the
+    // Resolver filled in for the statements this Interpreter runs.
+    explicit Interpreter(GlobalTable& globals, HeapConfig heapConfig = {});
     Environment* getEnvironment() const;
+    // The current environment chain, preceded by the current frame's slots
+    std::string environmentToString() const;
+    Heap& heap() { return m_heap; }
+    void markRoots(Heap& heap) override;
     void interpret(const std::vector<Stmt*>& statements);
 
     // ExprVisitor method implementations
-    LiteralValue visitLiteralExpr(const LiteralExpr &expr) override;
-    LiteralValue visitGroupingExpr(const GroupingExpr &expr) override;
-    LiteralValue visitUnaryExpr(const UnaryExpr &expr) override;
-    LiteralValue visitVariableExpr(const VariableExpr &expr) override;
-    LiteralValue visitBinaryExpr(const BinaryExpr &expr) override;
-    LiteralValue visitCallExpr(const CallExpr &expr) override;
-    LiteralValue visitGetExpr(const GetExpr &expr) override;
-    LiteralValue visitSetExpr(const SetExpr &expr) override;
-    LiteralValue visitThisExpr(const ThisExpr &expr) override;
-    LiteralValue visitSuperExpr(const SuperExpr &expr) override;
-    LiteralValue visitLogicalExpr(const LogicalExpr &expr) override;
-    LiteralValue visitAssignExpr(const AssignExpr &expr) override;
+    Value visitLiteralExpr(const LiteralExpr &expr) override;
+    Value visitGroupingExpr(const GroupingExpr &expr) override;
+    Value visitUnaryExpr(const UnaryExpr &expr) override;
+    Value visitVariableExpr(const VariableExpr &expr) override;
+    Value visitBinaryExpr(const BinaryExpr &expr) override;
+    Value visitCallExpr(const CallExpr &expr) override;
+    Value visitGetExpr(const GetExpr &expr) override;
+    Value visitSetExpr(const SetExpr &expr) override;
+    Value visitThisExpr(const ThisExpr &expr) override;
+    Value visitSuperExpr(const SuperExpr &expr) override;
+    Value visitLogicalExpr(const LogicalExpr &expr) override;
+    Value visitAssignExpr(const AssignExpr &expr) override;
 
     // StmtVisitor method implementations
     void visitExpressionStmt(const ExpressionStmt &stmt) override;
@@ -75,23 +58,120 @@ public:
     void visitReturnStmt(const ReturnStmt &stmt) override;
 
     // Public block execution method (needed by LoxFunction)
-    void executeBlock(const std::vector<Stmt*>& statements, std::shared_ptr<Environment> env);
+    Completion executeBlock(const std::vector<Stmt*>& statements, Environment* env);
+
+    // Takes the value of the `return` that ended the last function body
+    Value takeReturnValue();
+
+    // The collector only runs between statements, and only knows about the
+    // values reachable from environments. Any value a C++ frame holds while
+    // it evaluates, executes or calls something else must be pushed here; it
+    // stays a root until the Roots goes out of scope.
+    class Roots {
+    public:
+        explicit Roots(Interpreter& interpreter)
+            : m_stack(interpreter.m_stack), m_base(m_stack.size()) {}
+        ~Roots() { m_stack.resize(m_base); }
+        Roots(const Roots&) = delete;
+        Roots& operator=(const Roots&) = delete;
+
+        Value push(Value value) {
+            m_stack.push_back(value);
+            return value;
+        }
+
+    private:
+        std::vector<Value>& m_stack;
+        size_t m_base;
+    };
+
+    // Gives a call (or an outermost top-level block) a stack frame with the
+    // `slots` for the locals no closure captures, until the Frame goes out of
+    // scope. A Frame without slots leaves the current frame alone.
+    class Frame {
+    public:
+        Frame(Interpreter& interpreter, const ScopeLayout& slots)
+            : m_interpreter(interpreter), m_roots(interpreter),
+              m_previous(interpreter.m_frame),
+              m_previousSlots(interpreter.m_frameSlots) {
+            if (!slots.names.empty()) {
+                std::vector<Value>& stack = interpreter.m_stack;
+                size_t base = stack.size();
+                stack.resize(base + slots.names.size());
+                interpreter.m_frame = stack.data() + base;
+                interpreter.m_frameSlots = &slots;
+            }
+        }
+        ~Frame() {
+            m_interpreter.m_frame = m_previous;
+            m_interpreter.m_frameSlots = m_previousSlots;
+        }
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        Value& operator[](int slot) { return m_interpreter.m_frame[slot]; }
+
+    private:
+        Interpreter& m_interpreter;
+        Roots m_roots;
+        Value* m_previous;
+        const ScopeLayout* m_previousSlots;
+    };
+
+    // Counts one call for as long as it runs, reporting "Stack overflow." at
+    // `expr` if calls are already nested kCallsMax deep.
+    class CallDepth {
+    public:
+        CallDepth(Interpreter& interpreter, const CallExpr& expr)
+            : m_interpreter(interpreter) {
+            if (m_interpreter.m_callDepth == kCallsMax) {
+                throw RuntimeError(expr.paren, "Stack overflow.");
+            }
+            m_interpreter.m_callDepth++;
+        }
+        ~CallDepth() { m_interpreter.m_callDepth--; }
+        CallDepth(const CallDepth&) = delete;
+        CallDepth& operator=(const CallDepth&) = delete;
+
+    private:
+        Interpreter& m_interpreter;
+    };
+
+    // As deep as the VM's frames go. lox runs scripts on a thread whose
+    // native stack is large enough to reach it.
+    static constexpr int kCallsMax = 16 * 1024;
 
 private:
-    std::shared_ptr<Environment> m_globals; // Global scope environment
-    std::shared_ptr<Environment> m_envptr;  // Current environment pointer
-    std::unordered_map<const Expr*, int> m_locals;
-
-    LiteralValue evaluate(const Expr& expr);
-    LiteralValue lookUpVariable(const Token&, const Expr&);
-    void execute(const Stmt& stmt);
-    void resolve(const Expr& expr, int depth);
-    bool isTruthy(const LiteralValue& value);
-    bool isEqual(const LiteralValue& a, const LiteralValue& b);
-    bool isNumber(const LiteralValue& value);
-    double getNumberValue(const LiteralValue& value);
-    void checkNumberOperand(const Token& op, const LiteralValue& operand);
-    void checkNumberOperand(const Token& op, const LiteralValue& left, const LiteralValue& right);
+    // A guard for calls with huge frames; most recursion hits kCallsMax
+    // first. Calls check it before pushing their arguments, and the Resolver
+    // limits frames to kFrameMax slots, so the stack is reserved with room
+    // for one more frame.
+    static constexpr size_t kStackMax = 256 * 1024;
+
+    // Declared first so it outlives everything that points into it.
+    Heap m_heap;
+    GlobalTable& m_globalTable;
+    Environment* m_globals; // Global scope environment
+    Environment* m_envptr;  // Current environment pointer
+    // Temporaries and call arguments (see Roots). Reserved up front and never
+    // reallocated, so arguments can be passed as spans into it.
+    std::vector<Value> m_stack;
+    Value* m_frame = nullptr; // Slots of the current Frame, within m_stack
+    const ScopeLayout* m_frameSlots = nullptr; // Their names, for __printEnv
+    int m_callDepth = 0;      // Calls currently running (see CallDepth)
+    // Set by break/continue/return, read back by execute()
+    Completion m_completion = Completion::NORMAL;
+    Value m_returnValue;
+
+    Value evaluate(const Expr& expr);
+    Value lookUpVariable(const Token& name, LocalSlot local);
+    Completion execute(const Stmt& stmt);
+    std::span<const Value> evaluateArguments(const CallExpr& expr, Roots& roots);
+    Value call(const CallExpr& expr, Value callee, Roots& roots);
+    void checkArity(const CallExpr& expr, int arity, size_t argumentCount);
+    void declare(LocalSlot local, Value value);
+    void checkNumberOperand(const Token& op, Value operand);
+    void checkNumberOperand(const Token& op, Value left, Value right);
 };
 
 #endif // INTERPRETER_H_ 
@@ -2,26 +2,36 @@
 #define LOX_CALLABLE_H_
 #pragma once
 
-#include <vector>
+#include <span>
 #include <string>
-#include "Expr.hpp"
+#include "Object.h"
+#include "Value.h"
 
 // Forward declarations to avoid circular dependency
 class Interpreter;
 
-class LoxCallable {
+class LoxCallable : public Obj {
 public:
-    virtual ~LoxCallable() = default;
+    LoxCallable() : Obj(ObjType::CALLABLE) {}
 
     // Returns the number of arguments this function expects
     virtual int arity() const = 0;
 
-    // Executes the function with the given arguments
-    virtual LiteralValue call(Interpreter& interpreter,
-                             const std::vector<LiteralValue>& arguments) = 0;
+    // Executes the function with the given arguments, which are a view of
+    // the Interpreter's stack and only valid for the duration of the call
+    virtual Value call(Interpreter& interpreter,
+                       std::span<const Value> arguments) = 0;
 
     // String representation of the callable
-    virtual std::string toString() const = 0;
+    std::string toString() const override = 0;
 };
 
+inline bool isCallable(Value value) {
+    return isObjType(value, ObjType::CALLABLE);
+}
+
+inline LoxCallable* asCallable(Value value) {
+    return static_cast<LoxCallable*>(value.asObj());
+}
+
 #endif // LOX_CALLABLE_H_
@@ -1,35 +1,49 @@
 #include "LoxClass.h"
+#include "Interpreter.h"
 #include "LoxInstance.h"
 #include <string>
 
-LiteralValue LoxClass::call(Interpreter &interpreter,
-                            const std::vector<LiteralValue> &arguments) {
-  std::shared_ptr<LoxInstance> instance =
-      std::make_shared<LoxInstance>(shared_from_this());
-  auto initializer = findMethod("init");
-  if (initializer) {
-    initializer->bind(instance)->call(interpreter, arguments);
+static const Symbol initSymbol = internSymbol("init");
+
+LoxClass::LoxClass(std::string name,
+                   std::unordered_map<Symbol, LoxFunction *> methods)
+    : m_name(std::move(name)), m_methods(std::move(methods)),
+      m_rootShape(std::make_unique<Shape>()) {
+  m_initializer = findMethod(initSymbol);
+  m_arity = m_initializer ? m_initializer->arity() : 0;
+}
+
+Value LoxClass::call(Interpreter &interpreter,
+                     std::span<const Value> arguments) {
+  Interpreter::Roots roots(interpreter);
+  LoxInstance *instance = interpreter.heap().allocate<LoxInstance>(this);
+  roots.push(instance);
+  if (m_initializer) {
+    m_initializer->invoke(interpreter, instance, arguments);
   }
   return instance;
 }
 
-int LoxClass::arity() const {
-  auto initializer = findMethod("init");
-  if (initializer) {
-    return initializer->arity();
+int LoxClass::arity() const { return m_arity; }
+
+std::string LoxClass::toString() const { return m_name; }
+
+// The shapes under m_rootShape aren't counted: they are shared by all the
+// class's instances, and there is one per field order they have used.
+size_t LoxClass::size() const {
+  return sizeof(LoxClass) + storageBytes(m_name) + storageBytes(m_methods);
+}
+
+void LoxClass::trace(Heap &heap) {
+  for (const auto &[name, method] : m_methods) {
+    heap.markObject(method);
   }
-  return 0;
 }
-std::string LoxClass::toString() const { return m_name; }
 
-std::shared_ptr<LoxFunction>
-LoxClass::findMethod(const std::string &name) const {
+LoxFunction *LoxClass::findMethod(Symbol name) const {
   auto it = m_methods.find(name);
   if (it != m_methods.end()) {
     return it->second;
   }
-  if (m_superclass) {
-    return m_superclass->findMethod(name);
-  }
   return nullptr;
 }
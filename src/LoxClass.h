@@ -3,32 +3,39 @@
 #pragma once
 #include "LoxCallable.h"
 #include "LoxFunction.h"
+#include "Shape.hpp"
 #include <memory>
 #include <string>
 #include <unordered_map>
 
-class LoxClass : public LoxCallable,
-                 public std::enable_shared_from_this<LoxClass> {
+class LoxClass : public LoxCallable {
   friend class LoxInstance;
 
 public:
-  LoxClass(std::string name) : m_name(name) {}
-  LoxClass(
-      std::string name, std::shared_ptr<LoxClass> superclass,
-      std::unordered_map<std::string, std::shared_ptr<LoxFunction>> methods)
-      : m_name(std::move(name)), m_superclass(superclass),
-        m_methods(std::move(methods)) {}
+  // `methods` must already include the inherited ones (see
+  // Interpreter::visitClassStmt), so a lookup never walks up the hierarchy.
+  LoxClass(std::string name, std::unordered_map<Symbol, LoxFunction *> methods);
 
-  LiteralValue call(Interpreter &interpreter,
-                    const std::vector<LiteralValue> &arguments) override;
+  Value call(Interpreter &interpreter,
+             std::span<const Value> arguments) override;
   int arity() const override;
   std::string toString() const override;
-  std::shared_ptr<LoxFunction> findMethod(const std::string &name) const;
+  size_t size() const override;
+  void trace(Heap &heap) override;
+  LoxFunction *findMethod(Symbol name) const;
+  const std::unordered_map<Symbol, LoxFunction *> &methods() const {
+    return m_methods;
+  }
 
 private:
   std::string m_name;
-  std::shared_ptr<LoxClass> m_superclass;
-  std::unordered_map<std::string, std::shared_ptr<LoxFunction>> m_methods;
+  std::unordered_map<Symbol, LoxFunction *> m_methods; // Own and inherited
+  LoxFunction *m_initializer; // nullptr if the class has no init
+  int m_arity;
+  // Shape of a new instance, and through it every shape its instances reach.
+  // Each class has its own, so an instance's shape also pins down its class
+  // and therefore its methods.
+  std::unique_ptr<Shape> m_rootShape;
 };
 
 #endif // LOXCLASS_H_
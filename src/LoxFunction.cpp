@@ -1,54 +1,75 @@
 #include "LoxFunction.h"
+#include "ClosureCompiler.h"
 #include "Interpreter.h"
-#include <memory>
+#include "LoxInstance.h"
 
 LoxFunction::LoxFunction(const FunctionStmt *declaration,
-                         std::shared_ptr<Environment> closure,
-                         bool isInitializer)
-    : m_declaration(declaration), m_closureptr(closure),
-      m_isInitializer(isInitializer) {}
+                         Environment *closure,
+                         const ScopeLayout &layout, bool isInitializer,
+                         const CompiledBlock *compiledBody)
+    : m_declaration(declaration), m_closureptr(closure), m_layout(layout),
+      m_isInitializer(isInitializer), m_compiledBody(compiledBody) {}
 
-LiteralValue LoxFunction::call(Interpreter &interpreter,
-                               const std::vector<LiteralValue> &arguments) {
+Value LoxFunction::call(Interpreter &interpreter,
+                        std::span<const Value> arguments) {
+  return invoke(interpreter, m_receiver, arguments);
+}
 
-  auto envptr = std::make_shared<Environment>(m_closureptr);
+Value LoxFunction::invoke(Interpreter &interpreter, LoxInstance *receiver,
+                          std::span<const Value> arguments) {
+  Interpreter::Frame frame(interpreter, m_declaration->frame);
 
-  // Bind arguments to parameters
-  for (size_t i = 0; i < m_declaration->params.size(); i++) {
-    envptr->define(m_declaration->params[i].lexeme, arguments[i]);
-  }
+  // Only a function whose locals are captured by closures needs a scope of
+  // its own; the rest of its variables live in the frame.
+  Environment *envptr =
+      m_declaration->hasScope
+          ? interpreter.heap().allocate<Environment>(m_closureptr, m_layout)
+          : m_closureptr;
+  auto bind = [&](LocalSlot local, Value value) {
+    if (local.isFrame()) {
+      frame[local.slot] = value;
+    } else {
+      envptr->define(value); // The receiver and parameters come first
+    }
+  };
 
-  /*std::cout << "\ncalling " << this->toString() << "\n" << envptr->toString()
-   * << std::endl;*/
+  if (receiver) {
+    bind(m_declaration->receiver, receiver);
+  }
+  for (size_t i = 0; i < arguments.size(); i++) {
+    bind(m_declaration->parameters[i], arguments[i]);
+  }
 
-  try {
-    interpreter.executeBlock(m_declaration->body, envptr);
-  } catch (const ReturnException &e) {
-    if (m_isInitializer) {
-      return m_closureptr->getAt(
-          0, Token(TokenType::THIS, "this", m_declaration->name.line));
-    }
-    return e.getValue();
+  Completion completion =
+      m_compiledBody
+          ? ClosureCompiler::executeBlock(interpreter, *m_compiledBody, envptr)
+          : interpreter.executeBlock(m_declaration->body, envptr);
+  Value result = nullptr; // nil if no return statement was executed
+  if (completion == Completion::RETURN) {
+    result = interpreter.takeReturnValue();
   }
 
   if (m_isInitializer) {
-    return m_closureptr->getAt(
-        0, Token(TokenType::THIS, "this", m_declaration->name.line));
+    return receiver;
   }
+  return result;
+}
 
-  // Return nil if no return statement was executed
-  return nullptr;
+LoxFunction *LoxFunction::bind(Heap &heap, LoxInstance *instance) {
+  LoxFunction *bound = heap.allocate<LoxFunction>(m_declaration, m_closureptr,
+                                                  m_layout, m_isInitializer,
+                                                  m_compiledBody);
+  bound->m_receiver = instance;
+  return bound;
 }
 
-std::shared_ptr<LoxFunction>
-LoxFunction::bind(std::shared_ptr<LoxInstance> instance) {
-  auto envptr = std::make_shared<Environment>(m_closureptr);
-  envptr->define("this", instance);
-  return std::make_shared<LoxFunction>(m_declaration, envptr, m_isInitializer);
+void LoxFunction::trace(Heap &heap) {
+  heap.markObject(m_closureptr);
+  heap.markObject(m_receiver);
 }
 
 int LoxFunction::arity() const { return m_declaration->params.size(); }
 
 std::string LoxFunction::toString() const {
-  return "<fn " + m_declaration->name.lexeme + ">";
+  return "<fn " + std::string(m_declaration->name.lexeme) + ">";
 }
@@ -2,8 +2,8 @@
 #define LOXFUNCTION_H_
 #pragma once
 
-#include <memory>
 #include <fmt/core.h>
+#include "Heap.h"
 #include "LoxCallable.h"
 #include "Stmt.hpp"
 #include "Environment.hpp"
@@ -13,16 +13,28 @@ class Interpreter;
 
 class LoxFunction : public LoxCallable {
 public:
-    explicit LoxFunction(const FunctionStmt* declaration, std::shared_ptr<Environment> closure, bool isInitializer);
-    LiteralValue call(Interpreter& interpreter, const std::vector<LiteralValue>& arguments) override;
-    std::shared_ptr<LoxFunction> bind(std::shared_ptr<class LoxInstance> instance);
+    // `compiledBody` is set by the ClosureCompiler, and runs instead of
+    // walking the declaration's body.
+    explicit LoxFunction(const FunctionStmt* declaration, Environment* closure,
+                         const ScopeLayout& layout, bool isInitializer,
+                         const struct CompiledBlock* compiledBody = nullptr);
+    void trace(Heap& heap) override;
+    Value call(Interpreter& interpreter, std::span<const Value> arguments) override;
+    // Calls a method on `receiver` without creating a bound method first
+    Value invoke(Interpreter& interpreter, class LoxInstance* receiver,
+                 std::span<const Value> arguments);
+    LoxFunction* bind(Heap& heap, class LoxInstance* instance);
     int arity() const override;
     std::string toString() const override;
+    size_t size() const override { return sizeof(LoxFunction); }
 
 private:
     const FunctionStmt* m_declaration;
-    std::shared_ptr<Environment> m_closureptr;
+    Environment* m_closureptr;
+    const ScopeLayout& m_layout; // The captured receiver, parameters and locals
     bool m_isInitializer;
+    const struct CompiledBlock* m_compiledBody;
+    class LoxInstance* m_receiver = nullptr; // Set on bound methods
 };
 
 #endif // LOXFUNCTION_H_
@@ -1,23 +1,78 @@
 #include "LoxInstance.h"
-#include <memory>
 
-LoxInstance::LoxInstance(std::shared_ptr<LoxClass> klass) : m_klass(klass) {}
-LiteralValue LoxInstance::get(const std::string &name) {
-  auto it = m_fields.find(name);
-  if (it != m_fields.end()) {
-    return it->second;
+LoxInstance::LoxInstance(LoxClass *klass)
+    : Obj(ObjType::LOX_INSTANCE), m_klass(klass),
+      m_shape(klass->m_rootShape.get()) {}
+
+Value LoxInstance::get(Heap &heap, const Token &name, PropertyCache &cache) {
+  Value field;
+  LoxFunction *method = getMethodOrField(name, cache, field);
+  if (method) {
+    return method->bind(heap, this);
+  }
+  return field;
+}
+
+LoxFunction *LoxInstance::getMethodOrField(const Token &name,
+                                           PropertyCache &cache, Value &field) {
+  if (const PropertyCache::Entry *entry = cache.find(m_shape)) {
+    if (!entry->method) {
+      field = m_fields[entry->slot];
+    }
+    return entry->method;
+  }
+
+  int slot = m_shape->slotOf(name.symbol);
+  if (slot >= 0) {
+    cache.add({m_shape->id, slot, m_shape, nullptr});
+    field = m_fields[slot];
+    return nullptr;
   }
 
-  auto method = m_klass->findMethod(name);
+  // Fields shadow methods, and the shape says this instance has no such
+  // field, so the method found here is right for every instance of the shape.
+  LoxFunction *method = m_klass->findMethod(name.symbol);
   if (method) {
-    return method->bind(shared_from_this());
+    cache.add({m_shape->id, -1, m_shape, method});
+    return method;
   }
 
-  throw std::runtime_error("Undefined property '" + name + "'.");
+  throw RuntimeError(name,
+                     "Undefined property '" + std::string(name.lexeme) + "'.");
 }
 
-void LoxInstance::set(const std::string &name, const LiteralValue &value) {
-  m_fields[name] = value;
+void LoxInstance::set(Heap &heap, Symbol name, Value value,
+                      PropertyCache &cache) {
+  int slot;
+  Shape *next;
+  if (const PropertyCache::Entry *entry = cache.find(m_shape)) {
+    slot = entry->slot;
+    next = entry->next;
+  } else {
+    slot = m_shape->slotOf(name);
+    next = m_shape;
+    if (slot < 0) {
+      slot = static_cast<int>(m_fields.size());
+      next = m_shape->withField(name);
+    }
+    cache.add({m_shape->id, slot, next, nullptr});
+  }
+
+  // A new field's slot is always the next one
+  m_shape = next;
+  if (slot < static_cast<int>(m_fields.size())) {
+    m_fields[slot] = value;
+  } else {
+    m_fields.push_back(value);
+    heap.resized(this);
+  }
+}
+
+void LoxInstance::trace(Heap &heap) {
+  heap.markObject(m_klass);
+  for (Value value : m_fields) {
+    heap.markValue(value);
+  }
 }
 
 std::string LoxInstance::toString() const {
@@ -2,20 +2,40 @@
 #define LOXINSTANCE_H_
 #pragma once
 #include <string>
-#include <memory>
+#include "Heap.h"
 #include "LoxClass.h"
-#include <unordered_map>
+#include "Shape.hpp"
+#include <vector>
 
-class LoxInstance: public std::enable_shared_from_this<LoxInstance> {
+class LoxInstance : public Obj {
 public:
-  LoxInstance(std::shared_ptr<LoxClass> klass);
-  std::string toString() const;
-  LiteralValue get(const std::string &name);
-  void set(const std::string &name, const LiteralValue &value);
+  LoxInstance(LoxClass *klass);
+  std::string toString() const override;
+  size_t size() const override {
+    return sizeof(LoxInstance) + storageBytes(m_fields);
+  }
+  void trace(Heap &heap) override;
+  // Property access through the calling site's inline cache
+  Value get(Heap &heap, const Token &name, PropertyCache &cache);
+  // Like get, but returns a method unbound (and `field` untouched) instead of
+  // binding it to this instance. nullptr means the property is a field.
+  LoxFunction *getMethodOrField(const Token &name, PropertyCache &cache,
+                                Value &field);
+  // Charges `heap` for the storage a new field takes
+  void set(Heap &heap, Symbol name, Value value, PropertyCache &cache);
 
 private:
-  std::shared_ptr<LoxClass> m_klass;
-  std::unordered_map<std::string, LiteralValue> m_fields;
+  LoxClass *m_klass;
+  Shape *m_shape;
+  std::vector<Value> m_fields; // Indexed by m_shape's slots
 };
 
+inline bool isInstance(Value value) {
+  return isObjType(value, ObjType::LOX_INSTANCE);
+}
+
+inline LoxInstance *asInstance(Value value) {
+  return static_cast<LoxInstance *>(value.asObj());
+}
+
 #endif // LOXINSTANCE_H_
@@ -0,0 +1,94 @@
+#include "MappedFile.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#if __has_include(<sys/mman.h>)
+#define LOX_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data(std::exchange(other.m_data, "")),
+      m_size(std::exchange(other.m_size, 0)),
+      m_mapped(std::exchange(other.m_mapped, false)),
+      m_buffer(std::move(other.m_buffer)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    m_data = std::exchange(other.m_data, "");
+    m_size = std::exchange(other.m_size, 0);
+    m_mapped = std::exchange(other.m_mapped, false);
+    m_buffer = std::move(other.m_buffer);
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string &path) {
+  close();
+#ifdef LOX_HAVE_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    return false;
+  }
+  // Only regular files have a size to map; pipes, FIFOs and devices report
+  // 0 and are read below instead
+  if (S_ISREG(info.st_mode)) {
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size == 0) {
+      ::close(fd);
+      return true;
+    }
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      m_data = static_cast<const char *>(data);
+      m_mapped = true;
+      ::close(fd);
+      return true;
+    }
+    m_size = 0;
+  }
+  ::close(fd);
+#endif
+  // Read to the end rather than asking for a size, which streams lack
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  std::string contents;
+  try {
+    contents.assign(std::istreambuf_iterator<char>(file),
+                    std::istreambuf_iterator<char>());
+  } catch (const std::ios_base::failure &) {
+    return false; // e.g. a directory
+  }
+  m_size = contents.size();
+  m_buffer = std::make_unique<char[]>(m_size);
+  contents.copy(m_buffer.get(), m_size);
+  m_data = m_buffer.get();
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef LOX_HAVE_MMAP
+  if (m_mapped) {
+    munmap(const_cast<char *>(m_data), m_size);
+  }
+#endif
+  m_buffer.reset();
+  m_data = "";
+  m_size = 0;
+  m_mapped = false;
+}
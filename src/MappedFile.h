@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Read-only view of a whole file's contents.
+ *
+ * Where the platform has mmap the file is mapped rather than copied, so
+ * opening a large file costs no read and pages are only touched when used.
+ * Elsewhere the contents are read into memory. Either way the view stays
+ * valid until the MappedFile is destroyed.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // Returns false if the file can't be opened or read
+  bool open(const std::string &path);
+
+  std::string_view contents() const { return {m_data, m_size}; }
+
+private:
+  void close();
+
+  const char *m_data = "";
+  size_t m_size = 0;
+  bool m_mapped = false;                // m_data is a mapping to unmap
+  std::unique_ptr<char[]> m_buffer;     // Or holds the contents
+};
+
+#endif // MAPPED_FILE_H_
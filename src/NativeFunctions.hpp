@@ -6,7 +6,6 @@
 #include "LoxCallable.h"
 #include <chrono>
 #include <iostream>
-#include <memory>
 
 // ClockFunction: Native function that returns current time in seconds
 class ClockFunction : public LoxCallable {
@@ -15,8 +14,8 @@ public:
     return 0; // Takes no arguments
   }
 
-  LiteralValue call(Interpreter &interpreter,
-                    const std::vector<LiteralValue> &arguments) override {
+  Value call(Interpreter &interpreter,
+             std::span<const Value> arguments) override {
     // Get current time since epoch in seconds
     auto now = std::chrono::system_clock::now();
     auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(now);
@@ -27,6 +26,7 @@ public:
   }
 
   std::string toString() const override { return "<native fn: clock>"; }
+  size_t size() const override { return sizeof(ClockFunction); }
 };
 
 class __printEnv : public LoxCallable {
@@ -35,24 +35,25 @@ public:
     return 0; // Takes no arguments
   }
 
-  LiteralValue call(Interpreter &interpreter,
-                    const std::vector<LiteralValue> &arguments) override {
-    std::cout << interpreter.getEnvironment()->toString() << std::endl;
+  Value call(Interpreter &interpreter,
+             std::span<const Value> arguments) override {
+    std::cout << interpreter.environmentToString() << std::endl;
     return nullptr;
   }
 
   std::string toString() const override { return "<native fn: __printEnv>"; }
+  size_t size() const override { return sizeof(__printEnv); }
 };
 
 // Factory function to create all native functions
-inline std::vector<std::pair<std::string, std::shared_ptr<LoxCallable>>>
-createNativeFunctions() {
-  std::vector<std::pair<std::string, std::shared_ptr<LoxCallable>>> functions;
+inline std::vector<std::pair<std::string, LoxCallable *>>
+createNativeFunctions(Heap &heap) {
+  std::vector<std::pair<std::string, LoxCallable *>> functions;
 
   // Add clock function
-  functions.push_back({"clock", std::make_shared<ClockFunction>()});
+  functions.push_back({"clock", heap.allocate<ClockFunction>()});
   // Add printEnv function
-  functions.push_back({"__printEnv", std::make_shared<__printEnv>()});
+  functions.push_back({"__printEnv", heap.allocate<__printEnv>()});
 
   return functions;
 }
@@ -0,0 +1,49 @@
+#include "Object.h"
+#include "Heap.h"
+
+ObjString::ObjString(std::string chars)
+    : Obj(ObjType::STRING), chars(std::move(chars)) {}
+
+void ObjFunction::trace(Heap &heap) {
+  heap.markObject(name);
+  for (Value constant : chunk.constants) {
+    heap.markValue(constant);
+  }
+}
+
+std::string ObjFunction::toString() const {
+  if (name == nullptr)
+    return "<script>";
+  return "<fn " + name->chars + ">";
+}
+
+void ObjUpvalue::trace(Heap &heap) { heap.markValue(closed); }
+
+void ObjClosure::trace(Heap &heap) {
+  heap.markObject(function);
+  for (ObjUpvalue *upvalue : upvalues) {
+    heap.markObject(upvalue);
+  }
+}
+
+void ObjClass::trace(Heap &heap) {
+  heap.markObject(name);
+  for (const auto &[methodName, method] : methods) {
+    heap.markObject(methodName);
+    heap.markObject(method);
+  }
+  heap.markObject(initializer);
+}
+
+void ObjInstance::trace(Heap &heap) {
+  heap.markObject(klass);
+  for (const auto &[fieldName, value] : fields) {
+    heap.markObject(fieldName);
+    heap.markValue(value);
+  }
+}
+
+void ObjBoundMethod::trace(Heap &heap) {
+  heap.markValue(receiver);
+  heap.markObject(method);
+}
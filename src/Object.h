@@ -0,0 +1,186 @@
+#ifndef OBJECT_H_
+#define OBJECT_H_
+#pragma once
+
+#include "Chunk.h"
+#include "Value.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Heap;
+class VM;
+
+enum class ObjType : uint8_t {
+  STRING,
+  FUNCTION,
+  NATIVE,
+  CLOSURE,
+  UPVALUE,
+  CLASS,
+  INSTANCE,
+  BOUND_METHOD,
+  // Objects of the tree-walking Interpreter
+  CALLABLE, // Any LoxCallable: functions, classes and natives
+  LOX_INSTANCE,
+  ENVIRONMENT,
+};
+
+/**
+ * Base class of every heap object referenced from a Value.
+ *
+ * Objects are allocated through Heap::allocate, which links them into the
+ * heap's object list; `trace` marks everything the object references so the
+ * mark-sweep collector can find it.
+ */
+class Obj {
+public:
+  explicit Obj(ObjType type) : type(type) {}
+  virtual ~Obj() = default;
+
+  Obj(const Obj &) = delete;
+  Obj &operator=(const Obj &) = delete;
+
+  virtual void trace(Heap &heap) {}
+  virtual std::string toString() const = 0;
+  // Bytes the object occupies, including the storage it owns. The heap
+  // charges it on allocation, and again (Heap::resized) once it grows.
+  virtual size_t size() const = 0;
+
+  const ObjType type;
+  bool isMarked = false;
+  size_t heapSize = 0; // Bytes charged to the heap for this object
+  Obj *next = nullptr;
+};
+
+// Bytes held outside an object by its containers, for Obj::size(). Hash
+// tables are counted as a bucket array plus one node per entry.
+template <typename T> size_t storageBytes(const std::vector<T> &vector) {
+  return vector.capacity() * sizeof(T);
+}
+template <typename K, typename V>
+size_t storageBytes(const std::unordered_map<K, V> &map) {
+  return map.bucket_count() * sizeof(void *) +
+         map.size() * (sizeof(std::pair<const K, V>) + 2 * sizeof(void *));
+}
+inline size_t storageBytes(const std::string &string) { return string.size(); }
+
+inline bool isObjType(Value value, ObjType type) {
+  return value.isObj() && value.asObj()->type == type;
+}
+
+class ObjString : public Obj {
+public:
+  explicit ObjString(std::string chars);
+  std::string toString() const override { return chars; }
+  size_t size() const override {
+    return sizeof(ObjString) + storageBytes(chars);
+  }
+
+  const std::string chars;
+};
+
+class ObjFunction : public Obj {
+public:
+  ObjFunction() : Obj(ObjType::FUNCTION) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override;
+  size_t size() const override { return sizeof(ObjFunction) + chunk.bytes(); }
+
+  int arity = 0;
+  int upvalueCount = 0;
+  int maxSlots = 1; // Stack slots its locals need, the callee's included
+  Chunk chunk;
+  ObjString *name = nullptr; // nullptr for the top-level script
+};
+
+using NativeFn = Value (*)(VM &vm, int argCount, Value *args);
+
+class ObjNative : public Obj {
+public:
+  ObjNative(std::string name, int arity, NativeFn function)
+      : Obj(ObjType::NATIVE), name(std::move(name)), arity(arity),
+        function(function) {}
+  std::string toString() const override {
+    return "<native fn: " + name + ">";
+  }
+  size_t size() const override {
+    return sizeof(ObjNative) + storageBytes(name);
+  }
+
+  const std::string name;
+  const int arity;
+  const NativeFn function;
+};
+
+class ObjUpvalue : public Obj {
+public:
+  explicit ObjUpvalue(Value *slot) : Obj(ObjType::UPVALUE), location(slot) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override { return "upvalue"; }
+  size_t size() const override { return sizeof(ObjUpvalue); }
+
+  Value *location; // Points into the VM stack until closed, then at `closed`
+  Value closed;
+  ObjUpvalue *nextOpen = nullptr;
+};
+
+class ObjClosure : public Obj {
+public:
+  explicit ObjClosure(ObjFunction *function)
+      : Obj(ObjType::CLOSURE), function(function),
+        upvalues(function->upvalueCount, nullptr) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override { return function->toString(); }
+  size_t size() const override {
+    return sizeof(ObjClosure) + storageBytes(upvalues);
+  }
+
+  ObjFunction *const function;
+  std::vector<ObjUpvalue *> upvalues;
+};
+
+class ObjClass : public Obj {
+public:
+  explicit ObjClass(ObjString *name) : Obj(ObjType::CLASS), name(name) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override { return name->chars; }
+  size_t size() const override {
+    return sizeof(ObjClass) + storageBytes(methods);
+  }
+
+  ObjString *const name;
+  // Keys are interned, so pointer identity is name identity.
+  std::unordered_map<ObjString *, ObjClosure *> methods;
+  ObjClosure *initializer = nullptr; // Cached "init", if any
+};
+
+class ObjInstance : public Obj {
+public:
+  explicit ObjInstance(ObjClass *klass) : Obj(ObjType::INSTANCE), klass(klass) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override {
+    return "<instance of " + klass->name->chars + ">";
+  }
+  size_t size() const override {
+    return sizeof(ObjInstance) + storageBytes(fields);
+  }
+
+  ObjClass *const klass;
+  std::unordered_map<ObjString *, Value> fields;
+};
+
+class ObjBoundMethod : public Obj {
+public:
+  ObjBoundMethod(Value receiver, ObjClosure *method)
+      : Obj(ObjType::BOUND_METHOD), receiver(receiver), method(method) {}
+  void trace(Heap &heap) override;
+  std::string toString() const override { return method->toString(); }
+  size_t size() const override { return sizeof(ObjBoundMethod); }
+
+  const Value receiver;
+  ObjClosure *const method;
+};
+
+#endif // OBJECT_H_
@@ -0,0 +1,369 @@
+#include "Optimizer.h"
+#include "Object.h"
+
+// The literal `expr` is, or nullptr if it isn't one
+static const LiteralExpr *literal(const Expr &expr) {
+  return dynamic_cast<const LiteralExpr *>(&expr);
+}
+
+static bool isString(Value value) {
+  return isObjType(value, ObjType::STRING);
+}
+
+static const std::string &chars(Value value) {
+  return static_cast<ObjString *>(value.asObj())->chars;
+}
+
+std::vector<Stmt *> Optimizer::optimize(const std::vector<Stmt *> &statements) {
+  if (!m_removed) {
+    m_removed = create<BlockStmt>(std::vector<Stmt *>{});
+    m_removed->hasScope = false;
+  }
+  m_lastStart = m_arena.mark();
+  m_lastDeclaresCode = false;
+  std::vector<Stmt *> out;
+  if (!optimize(statements, out)) {
+    return statements;
+  }
+  return out;
+}
+
+Expr *Optimizer::optimize(const Expr &expr) {
+  expr.accept(*this);
+  return std::exchange(m_expr, nullptr);
+}
+
+Stmt *Optimizer::optimize(const Stmt &stmt) {
+  stmt.accept(*this);
+  return std::exchange(m_stmt, nullptr);
+}
+
+bool Optimizer::optimize(const std::vector<Stmt *> &statements,
+                         std::vector<Stmt *> &out) {
+  bool changed = false;
+  out.clear();
+  for (Stmt *statement : statements) {
+    Stmt *optimized = optimize(*statement);
+    if (optimized) {
+      changed = true;
+    }
+    if (optimized != m_removed) {
+      out.push_back(optimized ? optimized : statement);
+    }
+  }
+  return changed;
+}
+
+// A string `value` is one the input's producer or m_strings already owns
+Expr *Optimizer::fold(Value value) { return create<LiteralExpr>(value); }
+
+// Expressions
+
+void Optimizer::visitBinaryExpr(const BinaryExpr &expr) {
+  Expr *newLeft = optimize(expr.left);
+  Expr *newRight = optimize(expr.right);
+  const Expr &left = newLeft ? *newLeft : expr.left;
+  const Expr &right = newRight ? *newRight : expr.right;
+
+  const LiteralExpr *a = literal(left);
+  const LiteralExpr *b = literal(right);
+  if (a && b) {
+    Value x = a->value;
+    Value y = b->value;
+    bool numbers = x.isNumber() && y.isNumber();
+    // Mirrors Interpreter::visitBinaryExpr, except that whatever would
+    // throw there is left for the runtime to report.
+    switch (expr.opcode) {
+    case BinaryOp::ADD:
+      if (isString(x) && isString(y)) {
+        m_expr = create<LiteralExpr>(m_strings.add(chars(x) + chars(y)));
+        return;
+      }
+      if (numbers) {
+        m_expr = fold(x.asNumber() + y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::SUBTRACT:
+      if (numbers) {
+        m_expr = fold(x.asNumber() - y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::MULTIPLY:
+      if (numbers) {
+        m_expr = fold(x.asNumber() * y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::DIVIDE:
+      if (numbers && y.asNumber() != 0) {
+        m_expr = fold(x.asNumber() / y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::GREATER:
+      if (numbers) {
+        m_expr = fold(x.asNumber() > y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::GREATER_EQUAL:
+      if (numbers) {
+        m_expr = fold(x.asNumber() >= y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::LESS:
+      if (numbers) {
+        m_expr = fold(x.asNumber() < y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::LESS_EQUAL:
+      if (numbers) {
+        m_expr = fold(x.asNumber() <= y.asNumber());
+        return;
+      }
+      break;
+    case BinaryOp::EQUAL:
+      m_expr = fold(valuesEqual(x, y));
+      return;
+    case BinaryOp::NOT_EQUAL:
+      m_expr = fold(!valuesEqual(x, y));
+      return;
+    }
+  }
+
+  if (newLeft || newRight) {
+    m_expr = create<BinaryExpr>(left, expr.op, right);
+  }
+}
+
+void Optimizer::visitLogicalExpr(const LogicalExpr &expr) {
+  Expr *newLeft = optimize(expr.left);
+  Expr *newRight = optimize(expr.right);
+  const Expr &left = newLeft ? *newLeft : expr.left;
+  const Expr &right = newRight ? *newRight : expr.right;
+
+  // The left operand decides which operand is the result
+  if (const LiteralExpr *a = literal(left)) {
+    bool leftWins = expr.opcode == LogicalOp::OR ? !a->value.isFalsey()
+                                                 : a->value.isFalsey();
+    m_expr = const_cast<Expr *>(leftWins ? &left : &right);
+    return;
+  }
+
+  if (newLeft || newRight) {
+    m_expr = create<LogicalExpr>(left, expr.op, right);
+  }
+}
+
+void Optimizer::visitUnaryExpr(const UnaryExpr &expr) {
+  Expr *newRight = optimize(expr.right);
+  const Expr &right = newRight ? *newRight : expr.right;
+
+  if (const LiteralExpr *operand = literal(right)) {
+    switch (expr.opcode) {
+    case UnaryOp::NEGATE:
+      if (operand->value.isNumber()) {
+        m_expr = fold(-operand->value.asNumber());
+        return;
+      }
+      break;
+    case UnaryOp::NOT:
+      m_expr = fold(operand->value.isFalsey());
+      return;
+    }
+  }
+
+  if (newRight) {
+    m_expr = create<UnaryExpr>(expr.op, right);
+  }
+}
+
+void Optimizer::visitLiteralExpr(const LiteralExpr &expr) {}
+
+void Optimizer::visitGroupingExpr(const GroupingExpr &expr) {
+  // Parentheses only matter to the parser
+  Expr *inner = optimize(expr.expr);
+  m_expr = inner ? inner : const_cast<Expr *>(&expr.expr);
+}
+
+void Optimizer::visitVariableExpr(const VariableExpr &expr) {}
+
+void Optimizer::visitAssignExpr(const AssignExpr &expr) {
+  if (Expr *value = optimize(expr.value)) {
+    AssignExpr *assign = create<AssignExpr>(expr.name, *value);
+    assign->local = expr.local;
+    m_expr = assign;
+  }
+}
+
+void Optimizer::visitCallExpr(const CallExpr &expr) {
+  Expr *newCallee = optimize(expr.callee);
+  bool changed = newCallee;
+  std::vector<Expr *> arguments;
+  for (Expr *argument : expr.arguments) {
+    Expr *optimized = optimize(*argument);
+    changed = changed || optimized;
+    arguments.push_back(optimized ? optimized : argument);
+  }
+  if (changed) {
+    m_expr = create<CallExpr>(newCallee ? *newCallee : expr.callee, expr.paren,
+                              arguments);
+  }
+}
+
+void Optimizer::visitGetExpr(const GetExpr &expr) {
+  if (Expr *object = optimize(expr.object)) {
+    m_expr = create<GetExpr>(*object, expr.name);
+  }
+}
+
+void Optimizer::visitSetExpr(const SetExpr &expr) {
+  Expr *newObject = optimize(expr.object);
+  Expr *newValue = optimize(expr.value);
+  if (newObject || newValue) {
+    m_expr = create<SetExpr>(newObject ? *newObject : expr.object, expr.name,
+                             newValue ? *newValue : expr.value);
+  }
+}
+
+void Optimizer::visitThisExpr(const ThisExpr &expr) {}
+
+void Optimizer::visitSuperExpr(const SuperExpr &expr) {}
+
+// Statements
+
+void Optimizer::visitExpressionStmt(const ExpressionStmt &stmt) {
+  if (Expr *expression = optimize(stmt.expression)) {
+    m_stmt = create<ExpressionStmt>(*expression);
+  }
+}
+
+void Optimizer::visitPrintStmt(const PrintStmt &stmt) {
+  if (Expr *expression = optimize(stmt.expression)) {
+    m_stmt = create<PrintStmt>(*expression);
+  }
+}
+
+void Optimizer::visitVarStmt(const VarStmt &stmt) {
+  if (!stmt.initializer) {
+    return;
+  }
+  if (Expr *initializer = optimize(*stmt.initializer)) {
+    VarStmt *var = create<VarStmt>(stmt.name, initializer);
+    var->local = stmt.local;
+    m_stmt = var;
+  }
+}
+
+void Optimizer::visitIfStmt(const IfStmt &stmt) {
+  Expr *newCondition = optimize(stmt.condition);
+  const Expr &condition = newCondition ? *newCondition : stmt.condition;
+
+  // Branches are statements, not declarations, so dropping one can't
+  // change which variables the other sees.
+  if (const LiteralExpr *constant = literal(condition)) {
+    const Stmt *taken =
+        constant->value.isFalsey() ? stmt.elseBranch : &stmt.thenBranch;
+    if (!taken) {
+      m_stmt = m_removed;
+      return;
+    }
+    Stmt *optimized = optimize(*taken);
+    m_stmt = optimized ? optimized : const_cast<Stmt *>(taken);
+    return;
+  }
+
+  Stmt *newThen = optimize(stmt.thenBranch);
+  Stmt *newElse = stmt.elseBranch ? optimize(*stmt.elseBranch) : nullptr;
+  if (newCondition || newThen || newElse) {
+    const Stmt *elseBranch = newElse ? newElse : stmt.elseBranch;
+    if (elseBranch == m_removed) {
+      elseBranch = nullptr;
+    }
+    m_stmt = create<IfStmt>(condition, newThen ? *newThen : stmt.thenBranch,
+                            elseBranch);
+  }
+}
+
+void Optimizer::visitWhileStmt(const WhileStmt &stmt) {
+  Expr *newCondition = optimize(stmt.condition);
+  const Expr &condition = newCondition ? *newCondition : stmt.condition;
+
+  if (const LiteralExpr *constant = literal(condition)) {
+    if (constant->value.isFalsey()) {
+      m_stmt = m_removed; // Never runs, not even the increment
+      return;
+    }
+  }
+
+  Stmt *newBody = optimize(stmt.body);
+  Stmt *newIncrement = stmt.increment ? optimize(*stmt.increment) : nullptr;
+  if (newCondition || newBody || newIncrement) {
+    const Stmt *increment = newIncrement ? newIncrement : stmt.increment;
+    if (increment == m_removed) {
+      increment = nullptr;
+    }
+    m_stmt = create<WhileStmt>(condition, newBody ? *newBody : stmt.body,
+                               increment);
+  }
+}
+
+void Optimizer::visitBlockStmt(const BlockStmt &stmt) {
+  std::vector<Stmt *> statements;
+  if (optimize(stmt.statements, statements)) {
+    BlockStmt *block = create<BlockStmt>(std::move(statements));
+    block->layout = stmt.layout;
+    block->hasScope = stmt.hasScope;
+    block->frame = stmt.frame;
+    m_stmt = block;
+  }
+}
+
+void Optimizer::visitFunctionStmt(const FunctionStmt &stmt) {
+  m_lastDeclaresCode = true;
+  std::vector<Stmt *> body;
+  if (optimize(stmt.body, body)) {
+    FunctionStmt *function = create<FunctionStmt>(stmt.name, stmt.params, body);
+    function->local = stmt.local;
+    function->receiver = stmt.receiver;
+    function->parameters = stmt.parameters;
+    function->frame = stmt.frame;
+    function->layout = stmt.layout;
+    function->hasScope = stmt.hasScope;
+    m_stmt = function;
+  }
+}
+
+void Optimizer::visitClassStmt(const ClassStmt &stmt) {
+  m_lastDeclaresCode = true;
+  bool changed = false;
+  std::vector<FunctionStmt *> methods;
+  for (FunctionStmt *method : stmt.methods) {
+    auto *optimized = static_cast<FunctionStmt *>(optimize(*method));
+    changed = changed || optimized;
+    methods.push_back(optimized ? optimized : method);
+  }
+  if (changed) {
+    ClassStmt *klass =
+        create<ClassStmt>(stmt.name, std::move(methods), stmt.superclass);
+    klass->local = stmt.local;
+    m_stmt = klass;
+  }
+}
+
+void Optimizer::visitReturnStmt(const ReturnStmt &stmt) {
+  if (!stmt.value) {
+    return;
+  }
+  if (Expr *value = optimize(*stmt.value)) {
+    m_stmt = create<ReturnStmt>(stmt.keyword, value);
+  }
+}
+
+void Optimizer::visitBreakStmt(const BreakStmt &stmt) {}
+
+void Optimizer::visitContinueStmt(const ContinueStmt &stmt) {}
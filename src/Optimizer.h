@@ -0,0 +1,88 @@
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+#pragma once
+
+#include "Arena.hpp"
+#include "Expr.hpp"
+#include "Stmt.hpp"
+#include <vector>
+
+/**
+ * Optional pass (`-O`) between the Resolver and the back ends that folds
+ * constant expressions and drops code constant conditions make dead.
+ *
+ * It folds operators whose operands are literals, short-circuits logical
+ * operators with a literal left operand, and replaces if/while statements
+ * whose condition is a literal by the branch that runs. An operation that
+ * would fail at runtime (`-"a"`, `1 / 0`) is left alone, so the error is
+ * still reported by the runtime at its original line.
+ *
+ * The AST is immutable, so a node whose children change is rebuilt, keeping
+ * the Resolver's results. Unchanged subtrees are shared with the input.
+ */
+class Optimizer : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+  // The returned program points into both the input and the Optimizer,
+  // which must outlive it.
+  std::vector<Stmt *> optimize(const std::vector<Stmt *> &statements);
+
+  // Frees the nodes the last optimize() created, unless they include a
+  // function or class, which the runtime goes on pointing to. Nothing else
+  // may still refer to them (see Parser::releaseLast).
+  void releaseLast() {
+    if (!m_lastDeclaresCode) {
+      m_arena.rewind(m_lastStart);
+    }
+  }
+
+  void visitBinaryExpr(const BinaryExpr &expr) override;
+  void visitLogicalExpr(const LogicalExpr &expr) override;
+  void visitUnaryExpr(const UnaryExpr &expr) override;
+  void visitLiteralExpr(const LiteralExpr &expr) override;
+  void visitGroupingExpr(const GroupingExpr &expr) override;
+  void visitVariableExpr(const VariableExpr &expr) override;
+  void visitAssignExpr(const AssignExpr &expr) override;
+  void visitCallExpr(const CallExpr &expr) override;
+  void visitGetExpr(const GetExpr &expr) override;
+  void visitSetExpr(const SetExpr &expr) override;
+  void visitThisExpr(const ThisExpr &expr) override;
+  void visitSuperExpr(const SuperExpr &expr) override;
+
+  void visitExpressionStmt(const ExpressionStmt &stmt) override;
+  void visitClassStmt(const ClassStmt &stmt) override;
+  void visitFunctionStmt(const FunctionStmt &stmt) override;
+  void visitIfStmt(const IfStmt &stmt) override;
+  void visitPrintStmt(const PrintStmt &stmt) override;
+  void visitVarStmt(const VarStmt &stmt) override;
+  void visitWhileStmt(const WhileStmt &stmt) override;
+  void visitBlockStmt(const BlockStmt &stmt) override;
+  void visitBreakStmt(const BreakStmt &stmt) override;
+  void visitContinueStmt(const ContinueStmt &stmt) override;
+  void visitReturnStmt(const ReturnStmt &stmt) override;
+
+private:
+  // Each returns the replacement for a node, or nullptr if it is unchanged.
+  // A statement that no longer does anything is replaced by m_removed.
+  Expr *optimize(const Expr &expr);
+  Stmt *optimize(const Stmt &stmt);
+  // Whether any statement changed; if so `out` is the new list, without
+  // removed statements.
+  bool optimize(const std::vector<Stmt *> &statements,
+                std::vector<Stmt *> &out);
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    return m_arena.create<T>(std::forward<Args>(args)...);
+  }
+  Expr *fold(Value value);
+
+  Arena m_arena;            // Owns the nodes this pass creates
+  LiteralStrings m_strings; // Strings concatenated at compile time
+  Expr *m_expr = nullptr;   // Result of the last visit*Expr
+  Stmt *m_stmt = nullptr;   // Result of the last visit*Stmt
+  // Stands in for removed statements, and is itself an empty block
+  BlockStmt *m_removed = nullptr;
+  Arena::Mark m_lastStart{}; // Where the last optimize()'s nodes start
+  bool m_lastDeclaresCode = false;
+};
+
+#endif // OPTIMIZER_H_
@@ -0,0 +1,159 @@
+#include "ParallelParser.h"
+#include "ScanKernels.h"
+#include "error.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+// Below this, a chunk isn't worth a thread
+static constexpr size_t kMinChunkSize = 256 * 1024;
+
+static bool isIdentifierChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// Whether the next word after `p` starts a declaration that no statement
+// could be continuing
+static bool startsDeclaration(const char *p, const char *end) {
+  int lines = 0;
+  p = scan::skipBlanks(p, end, lines);
+  for (std::string_view keyword : {"fun", "class", "var"}) {
+    if (static_cast<size_t>(end - p) >= keyword.size() &&
+        std::string_view(p, keyword.size()) == keyword &&
+        (p + keyword.size() == end || !isIdentifierChar(p[keyword.size()]))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<ParallelParser::Chunk>
+ParallelParser::split(size_t chunks) const {
+  const char *begin = m_source.data();
+  const char *end = begin + m_source.size();
+  const size_t target = m_source.size() / chunks;
+
+  std::vector<Chunk> result;
+  const char *start = begin;
+  int startLine = 1;
+  int line = 1;
+  int depth = 0; // Of braces and parentheses together
+  const char *p = begin;
+  while (p < end) {
+    char c = *p++;
+    switch (c) {
+    case '\n':
+      line++;
+      break;
+    case '"':
+      p = scan::find(p, end, '"', line);
+      if (p == end) {
+        return {};
+      }
+      p++;
+      break;
+    case '/':
+      if (p < end && *p == '/') {
+        int lines = 0;
+        p = scan::find(p, end, '\n', lines);
+      } else if (p < end && *p == '*') {
+        p++;
+        while (true) {
+          p = scan::find(p, end, '*', line);
+          if (p == end) {
+            return {};
+          }
+          p++;
+          if (p < end && *p == '/') {
+            p++;
+            break;
+          }
+        }
+      }
+      break;
+    case '(':
+    case '{':
+      depth++;
+      break;
+    case ')':
+    case '}':
+    case ';':
+      if (c != ';' && --depth < 0) {
+        return {};
+      }
+      if (c != ')' && depth == 0 && static_cast<size_t>(p - start) >= target &&
+          startsDeclaration(p, end)) {
+        result.push_back({std::string_view(start, p - start), startLine});
+        start = p;
+        startLine = line;
+      }
+      break;
+    default:
+      if (isIdentifierChar(c)) {
+        p = scan::skipIdentifier(p, end);
+      }
+      break;
+    }
+  }
+  if (depth != 0 || result.empty()) {
+    return {};
+  }
+  result.push_back({std::string_view(start, end - start), startLine});
+  return result;
+}
+
+std::vector<Stmt *> ParallelParser::parseAlone() {
+  m_scanners.clear();
+  m_parsers.clear();
+  m_scanners.push_back(std::make_unique<Scanner>(m_source));
+  m_parsers.push_back(std::make_unique<Parser>(*m_scanners.back()));
+  return m_parsers.back()->parse();
+}
+
+std::vector<Stmt *> ParallelParser::parse() {
+  // A few chunks per thread evens out their differences in cost
+  size_t wanted = std::min<size_t>(size_t{m_threads} * 4,
+                                   m_source.size() / kMinChunkSize);
+  if (m_threads < 2 || wanted < 2) {
+    return parseAlone();
+  }
+  std::vector<Chunk> chunks = split(wanted);
+  if (chunks.empty()) {
+    return parseAlone();
+  }
+
+  size_t count = chunks.size();
+  m_scanners.resize(count);
+  m_parsers.resize(count);
+  std::vector<std::vector<Stmt *>> parsed(count);
+  std::unique_ptr<bool[]> failed(new bool[count]());
+  std::atomic<size_t> next{0};
+  auto work = [&] {
+    for (size_t i; (i = next.fetch_add(1)) < count;) {
+      lox::divertErrors(&failed[i]);
+      m_scanners[i] =
+          std::make_unique<Scanner>(chunks[i].text, chunks[i].line);
+      m_parsers[i] = std::make_unique<Parser>(*m_scanners[i]);
+      parsed[i] = m_parsers[i]->parse();
+      lox::divertErrors(nullptr);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < std::min<size_t>(m_threads, count); i++) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+
+  std::vector<Stmt *> statements;
+  for (size_t i = 0; i < count; i++) {
+    if (failed[i]) {
+      return parseAlone();
+    }
+    statements.insert(statements.end(), parsed[i].begin(), parsed[i].end());
+  }
+  return statements;
+}
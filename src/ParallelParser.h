@@ -0,0 +1,55 @@
+#ifndef PARALLEL_PARSER_H_
+#define PARALLEL_PARSER_H_
+#pragma once
+
+#include "Parser.hpp"
+#include "Scanner.h"
+#include "Stmt.hpp"
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/**
+ * Scans and parses a large script on several threads (`--parse-threads`).
+ *
+ * A quick pass over the source finds top-level boundaries: a `;` or `}`
+ * outside any braces, parentheses, strings and comments that is followed by
+ * `fun`, `class` or `var`. The source is cut at some of them into chunks of
+ * about equal size, each chunk gets its own Scanner and Parser on a pool of
+ * threads, and their statements are joined in source order. Tokens keep
+ * their place in the source and their line numbers, so the result is the
+ * program a single Parser would have built.
+ *
+ * If any chunk has a syntax error, the whole source is parsed again on the
+ * calling thread, so errors are reported exactly as they always are.
+ */
+class ParallelParser {
+public:
+  ParallelParser(std::string_view source, unsigned threads)
+      : m_source(source), m_threads(threads) {}
+
+  ParallelParser(const ParallelParser &) = delete;
+  ParallelParser &operator=(const ParallelParser &) = delete;
+
+  // The statements live as long as the ParallelParser.
+  std::vector<Stmt *> parse();
+
+private:
+  struct Chunk {
+    std::string_view text;
+    int line; // The line `text` starts on
+  };
+
+  // Empty if the source has no boundaries to cut at, or doesn't scan
+  // cleanly enough to trust the ones it has
+  std::vector<Chunk> split(size_t chunks) const;
+  std::vector<Stmt *> parseAlone();
+
+  std::string_view m_source;
+  unsigned m_threads;
+  // One per chunk; the parsers own the program's nodes
+  std::vector<std::unique_ptr<Scanner>> m_scanners;
+  std::vector<std::unique_ptr<Parser>> m_parsers;
+};
+
+#endif // PARALLEL_PARSER_H_
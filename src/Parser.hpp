@@ -1,8 +1,15 @@
 #pragma once
+#include "Arena.hpp"
 #include "Expr.hpp"
+#include "Object.h"
+#include "Scanner.h"
 #include "Stmt.hpp"
 #include "Token.h"
 #include "error.h"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
 class ParseError : public std::exception {
@@ -14,18 +21,10 @@ public:
 
 class Parser {
 public:
-  [[nodiscard]] explicit Parser(const std::vector<Token> &tokens)
-      : m_tokens(tokens) {};
-
-  // Destructor
-  ~Parser() {
-    // Clean up all allocated expressions and statements
-    for (Expr *expr : m_allocated_exprs) {
-      delete expr;
-    }
-    for (Stmt *stmt : m_allocated_stmts) {
-      delete stmt;
-    }
+  // Tokens are pulled from `scanner` as parsing reaches them, so it must
+  // outlive parse(); scanning and parsing proceed together.
+  [[nodiscard]] explicit Parser(Scanner &scanner) : m_scanner(scanner) {
+    m_window[0] = m_scanner.nextToken();
   }
 
   // Prevent copying and moving
@@ -42,18 +41,31 @@ public:
     return statements;
   }
 
+  // For running a program one top-level declaration at a time: whether all
+  // of them have been parsed, and the next one (nullptr after a syntax
+  // error).
+  bool done() const { return isAtEnd(); }
+
+  Stmt *next() {
+    m_lastStart = m_arena.mark();
+    m_lastDeclaresCode = false;
+    return declaration();
+  }
+
+  // Frees the nodes of the declaration next() returned last, unless it
+  // declares a function or class, which the runtime goes on pointing to.
+  // Nothing else may still refer to them.
+  void releaseLast() {
+    if (!m_lastDeclaresCode) {
+      m_arena.rewind(m_lastStart);
+    }
+  }
+
 private:
-  // Helper function to track allocated expressions
+  // Every node lives in the parser's arena and is freed with it
   template <typename T, typename... Args> T *allocate(Args &&...args) {
-    if constexpr (std::is_base_of_v<Expr, T>) {
-      T *expr = new T(std::forward<Args>(args)...);
-      m_allocated_exprs.push_back(expr);
-      return expr;
-    } else if constexpr (std::is_base_of_v<Stmt, T>) {
-      T *stmt = new T(std::forward<Args>(args)...);
-      m_allocated_stmts.push_back(stmt);
-      return stmt;
-    }
+    static_assert(std::is_base_of_v<Expr, T> || std::is_base_of_v<Stmt, T>);
+    return m_arena.create<T>(std::forward<Args>(args)...);
   }
 
   Stmt *declaration() {
@@ -73,6 +85,7 @@ private:
   }
 
   Stmt *classDeclaration() {
+    m_lastDeclaresCode = true;
     Token name = consume(TokenType::IDENTIFIER, "Expect class name.");
     VariableExpr *superclass = nullptr;
     if (match({TokenType::LESS})) {
@@ -89,6 +102,7 @@ private:
   }
 
   FunctionStmt *function(const std::string &kind) {
+    m_lastDeclaresCode = true;
     Token name = consume(TokenType::IDENTIFIER, "Expect " + kind + " name.");
     consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
     std::vector<Token> parameters;
@@ -349,11 +363,24 @@ private:
     if (match({TokenType::BANG, TokenType::MINUS})) {
       Token op = previous();
       Expr *right = unary();
+      // Integer literals negate as integers, so `-0` is 0 rather than the
+      // double -0; for any other number the two agree
+      if (op.type == TokenType::MINUS && isIntegerZero(right)) {
+        return right;
+      }
       return allocate<UnaryExpr>(op, *right);
     }
     return call();
   }
 
+  // Whether `exprptr`, just parsed, is the literal 0 written without a '.'
+  bool isIntegerZero(const Expr *exprptr) const {
+    auto *literal = dynamic_cast<const LiteralExpr *>(exprptr);
+    return literal && previous().type == TokenType::NUMBER &&
+           previous().lexeme.find('.') == std::string_view::npos &&
+           literal->value.asNumber() == 0;
+  }
+
   Expr *call() {
     // call -> primary ( "(" arguments? ")" | "." IDENTIFIER )* ;
     Expr *exprptr = primary();
@@ -397,13 +424,15 @@ private:
     if (match({TokenType::NIL}))
       return allocate<LiteralExpr>();
     if (match({TokenType::NUMBER})) {
-      if (previous().lexeme.find('.') != std::string::npos)
-        return allocate<LiteralExpr>(std::stod(previous().lexeme));
-      return allocate<LiteralExpr>(std::stoi(previous().lexeme));
+      std::string_view text = previous().lexeme;
+      double number = 0;
+      std::from_chars(text.data(), text.data() + text.size(), number);
+      return allocate<LiteralExpr>(number);
+    }
+    if (match({TokenType::STRING})) {
+      return allocate<LiteralExpr>(m_strings.add(std::string(
+          previous().lexeme.substr(1, previous().lexeme.size() - 2))));
     }
-    if (match({TokenType::STRING}))
-      return allocate<LiteralExpr>(
-          previous().lexeme.substr(1, previous().lexeme.size() - 2));
     if (match({TokenType::THIS}))
       return allocate<ThisExpr>(previous());
     if (match({TokenType::SUPER})) {
@@ -460,7 +489,7 @@ private:
     return false;
   }
 
-  Token consume(TokenType type, const std::string &message) {
+  const Token &consume(TokenType type, const std::string &message) {
     if (!check(type))
       throw error(peek(), message);
     return advance();
@@ -472,22 +501,32 @@ private:
     return peek().type == type;
   }
 
-  Token advance() {
+  // The returned token, like peek() and previous(), is only valid until the
+  // next advance; keep a copy of any token needed past that.
+  const Token &advance() {
     if (!isAtEnd()) {
       m_current++;
+      m_window[m_current % kWindow] = m_scanner.nextToken();
     }
     return previous();
   }
 
-  Token peek() const { return m_tokens[m_current]; }
+  const Token &peek() const { return m_window[m_current % kWindow]; }
 
-  Token previous() const { return m_tokens[m_current - 1]; }
+  const Token &previous() const { return m_window[(m_current - 1) % kWindow]; }
 
   bool isAtEnd() const { return peek().type == TokenType::END_OF_FILE; }
 
 private:
-  std::vector<Token> m_tokens;
-  std::vector<Expr *> m_allocated_exprs; // Track allocated expressions
-  std::vector<Stmt *> m_allocated_stmts; // Track allocated statements
-  int m_current = 0;
+  // The parser never looks further than one token either side of m_current,
+  // so only the current and previous tokens are kept, in a two-slot ring.
+  static constexpr int kWindow = 2;
+
+  Scanner &m_scanner;
+  std::array<Token, kWindow> m_window{};
+  Arena m_arena; // Owns all AST nodes of this parse
+  LiteralStrings m_strings; // Outlive their nodes, which releaseLast() frees
+  Arena::Mark m_lastStart{}; // Where the last declaration's nodes start
+  bool m_lastDeclaresCode = false;
+  int64_t m_current = 0; // Tokens consumed so far
 };
@@ -0,0 +1,1022 @@
+#include "ProgramCache.h"
+#include "MappedFile.h"
+#include "Object.h"
+#include <bit>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <utility>
+
+// Bump whenever the AST or anything the Resolver stores on it changes
+static constexpr uint32_t kFormatVersion = 3;
+static constexpr char kMagic[4] = {'L', 'O', 'X', 'C'};
+
+enum class Tag : uint8_t {
+  NONE, // A null child
+  BINARY,
+  LOGICAL,
+  UNARY,
+  LITERAL,
+  GROUPING,
+  VARIABLE,
+  ASSIGN,
+  CALL,
+  GET,
+  SET,
+  THIS,
+  SUPER,
+  EXPRESSION_STMT,
+  CLASS_STMT,
+  FUNCTION_STMT,
+  IF_STMT,
+  PRINT_STMT,
+  VAR_STMT,
+  WHILE_STMT,
+  BLOCK_STMT,
+  BREAK_STMT,
+  CONTINUE_STMT,
+  RETURN_STMT,
+};
+
+// FNV-1a
+static uint64_t hashBytes(std::string_view bytes) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : bytes) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string ProgramCache::pathFor(std::string_view source) const {
+  char name[32];
+  std::snprintf(name, sizeof name, "%016llx.loxc",
+                static_cast<unsigned long long>(hashBytes(source)));
+  return (std::filesystem::path(m_directory) / name).string();
+}
+
+// Writing
+
+namespace {
+
+// Serializes a resolved program. 32-bit integers are LEB128 varints (signed
+// ones zigzag-encoded first), since nearly all are small; 64-bit ones are
+// little-endian whatever the host.
+class Writer : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+  explicit Writer(std::string_view source) : m_source(source) {}
+
+  std::string &out() { return m_out; }
+
+  void u8(uint8_t value) { m_out.push_back(static_cast<char>(value)); }
+  void u32(uint32_t value) {
+    while (value >= 0x80) {
+      u8(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    u8(static_cast<uint8_t>(value));
+  }
+  void u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+      u8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+  }
+  void i32(int value) {
+    u32((static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+  }
+  void text(std::string_view text) {
+    u32(static_cast<uint32_t>(text.size()));
+    m_out.append(text);
+  }
+  void tag(Tag tag) { u8(static_cast<uint8_t>(tag)); }
+
+  void token(const Token &token) {
+    u8(static_cast<uint8_t>(token.type));
+    i32(token.line);
+    const char *begin = m_source.data();
+    const char *end = begin + m_source.size();
+    bool inSource = token.lexeme.data() >= begin &&
+                    token.lexeme.data() + token.lexeme.size() <= end;
+    u8((inSource ? 1 : 0) | (token.symbol != kNoSymbol ? 2 : 0));
+    if (inSource) {
+      u32(static_cast<uint32_t>(token.lexeme.data() - begin));
+      u32(static_cast<uint32_t>(token.lexeme.size()));
+    } else {
+      text(token.lexeme);
+    }
+  }
+
+  void slot(LocalSlot local) {
+    u8(static_cast<uint8_t>(local.storage));
+    i32(local.depth);
+    i32(local.slot);
+  }
+
+  void layout(const ScopeLayout &layout) {
+    u32(static_cast<uint32_t>(layout.names.size()));
+    for (Symbol name : layout.names) {
+      text(symbolName(name));
+    }
+  }
+
+  void expr(const Expr *expr) {
+    if (!expr) {
+      tag(Tag::NONE);
+      return;
+    }
+    expr->accept(*this);
+  }
+
+  void stmt(const Stmt *stmt) {
+    if (!stmt) {
+      tag(Tag::NONE);
+      return;
+    }
+    stmt->accept(*this);
+  }
+
+  void statements(const std::vector<Stmt *> &statements) {
+    u32(static_cast<uint32_t>(statements.size()));
+    for (const Stmt *statement : statements) {
+      stmt(statement);
+    }
+  }
+
+  void visitBinaryExpr(const BinaryExpr &expr) override {
+    tag(Tag::BINARY);
+    this->expr(&expr.left);
+    token(expr.op);
+    this->expr(&expr.right);
+  }
+
+  void visitLogicalExpr(const LogicalExpr &expr) override {
+    tag(Tag::LOGICAL);
+    this->expr(&expr.left);
+    token(expr.op);
+    this->expr(&expr.right);
+  }
+
+  void visitUnaryExpr(const UnaryExpr &expr) override {
+    tag(Tag::UNARY);
+    token(expr.op);
+    this->expr(&expr.right);
+  }
+
+  void visitLiteralExpr(const LiteralExpr &expr) override {
+    tag(Tag::LITERAL);
+    Value value = expr.value;
+    if (isObjType(value, ObjType::STRING)) {
+      u8(static_cast<uint8_t>(ValueType::OBJ));
+      text(static_cast<ObjString *>(value.asObj())->chars);
+    } else if (value.isNumber()) {
+      u8(static_cast<uint8_t>(ValueType::NUMBER));
+      u64(std::bit_cast<uint64_t>(value.asNumber()));
+    } else if (value.isBool()) {
+      u8(static_cast<uint8_t>(ValueType::BOOL));
+      u8(value.asBool());
+    } else {
+      u8(static_cast<uint8_t>(ValueType::NIL));
+    }
+  }
+
+  void visitGroupingExpr(const GroupingExpr &expr) override {
+    tag(Tag::GROUPING);
+    this->expr(&expr.expr);
+  }
+
+  void visitVariableExpr(const VariableExpr &expr) override {
+    tag(Tag::VARIABLE);
+    token(expr.name);
+    slot(expr.local);
+  }
+
+  void visitAssignExpr(const AssignExpr &expr) override {
+    tag(Tag::ASSIGN);
+    token(expr.name);
+    this->expr(&expr.value);
+    slot(expr.local);
+  }
+
+  void visitCallExpr(const CallExpr &expr) override {
+    tag(Tag::CALL);
+    this->expr(&expr.callee);
+    token(expr.paren);
+    u32(static_cast<uint32_t>(expr.arguments.size()));
+    for (const Expr *argument : expr.arguments) {
+      this->expr(argument);
+    }
+  }
+
+  void visitGetExpr(const GetExpr &expr) override {
+    tag(Tag::GET);
+    this->expr(&expr.object);
+    token(expr.name);
+  }
+
+  void visitSetExpr(const SetExpr &expr) override {
+    tag(Tag::SET);
+    this->expr(&expr.object);
+    token(expr.name);
+    this->expr(&expr.value);
+  }
+
+  void visitThisExpr(const ThisExpr &expr) override {
+    tag(Tag::THIS);
+    token(expr.keyword);
+    slot(expr.local);
+  }
+
+  void visitSuperExpr(const SuperExpr &expr) override {
+    tag(Tag::SUPER);
+    token(expr.keyword);
+    token(expr.method);
+    slot(expr.local);
+    slot(expr.receiver);
+  }
+
+  void visitExpressionStmt(const ExpressionStmt &stmt) override {
+    tag(Tag::EXPRESSION_STMT);
+    expr(&stmt.expression);
+  }
+
+  void visitPrintStmt(const PrintStmt &stmt) override {
+    tag(Tag::PRINT_STMT);
+    expr(&stmt.expression);
+  }
+
+  void visitVarStmt(const VarStmt &stmt) override {
+    tag(Tag::VAR_STMT);
+    token(stmt.name);
+    expr(stmt.initializer);
+    slot(stmt.local);
+  }
+
+  void visitWhileStmt(const WhileStmt &stmt) override {
+    tag(Tag::WHILE_STMT);
+    expr(&stmt.condition);
+    this->stmt(&stmt.body);
+    this->stmt(stmt.increment);
+  }
+
+  void visitBlockStmt(const BlockStmt &stmt) override {
+    tag(Tag::BLOCK_STMT);
+    statements(stmt.statements);
+    layout(stmt.layout);
+    u8(stmt.hasScope);
+    layout(stmt.frame);
+  }
+
+  void visitIfStmt(const IfStmt &stmt) override {
+    tag(Tag::IF_STMT);
+    expr(&stmt.condition);
+    this->stmt(&stmt.thenBranch);
+    this->stmt(stmt.elseBranch);
+  }
+
+  void visitBreakStmt(const BreakStmt &stmt) override {
+    tag(Tag::BREAK_STMT);
+    token(stmt.keyword);
+  }
+
+  void visitContinueStmt(const ContinueStmt &stmt) override {
+    tag(Tag::CONTINUE_STMT);
+    token(stmt.keyword);
+  }
+
+  void visitClassStmt(const ClassStmt &stmt) override {
+    tag(Tag::CLASS_STMT);
+    token(stmt.name);
+    expr(stmt.superclass);
+    u32(static_cast<uint32_t>(stmt.methods.size()));
+    for (const FunctionStmt *method : stmt.methods) {
+      this->stmt(method);
+    }
+    slot(stmt.local);
+  }
+
+  void visitFunctionStmt(const FunctionStmt &stmt) override {
+    tag(Tag::FUNCTION_STMT);
+    token(stmt.name);
+    u32(static_cast<uint32_t>(stmt.params.size()));
+    for (size_t i = 0; i < stmt.params.size(); i++) {
+      token(stmt.params[i]);
+      slot(stmt.parameters[i]);
+    }
+    statements(stmt.body);
+    slot(stmt.local);
+    slot(stmt.receiver);
+    layout(stmt.frame);
+    layout(stmt.layout);
+    u8(stmt.hasScope);
+  }
+
+  void visitReturnStmt(const ReturnStmt &stmt) override {
+    tag(Tag::RETURN_STMT);
+    token(stmt.keyword);
+    expr(stmt.value);
+  }
+
+private:
+  std::string_view m_source;
+  std::string m_out;
+};
+
+// Thrown when an entry doesn't decode; the load is then a miss
+struct CorruptEntry {};
+
+class Reader {
+public:
+  Reader(std::string_view data, std::string_view source, Arena &arena,
+         std::deque<std::string> &texts, LiteralStrings &strings)
+      : m_next(data.data()), m_end(data.data() + data.size()),
+        m_source(source), m_arena(arena), m_texts(texts), m_strings(strings) {}
+
+  bool atEnd() const { return m_next == m_end; }
+
+  uint8_t u8() {
+    need(1);
+    return static_cast<uint8_t>(*m_next++);
+  }
+  uint32_t u32() {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t byte = u8();
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return value;
+      }
+    }
+    throw CorruptEntry();
+  }
+  uint64_t u64() {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+      value |= static_cast<uint64_t>(u8()) << (8 * i);
+    }
+    return value;
+  }
+  int i32() {
+    uint32_t value = u32();
+    return static_cast<int>((value >> 1) ^ (0u - (value & 1)));
+  }
+  std::string_view text() {
+    uint32_t size = u32();
+    need(size);
+    std::string_view text(m_next, size);
+    m_next += size;
+    return text;
+  }
+
+  // A count of things that each take at least one byte, checked against
+  // what's left so a damaged count can't cause a huge allocation
+  uint32_t count() {
+    uint32_t count = u32();
+    need(count);
+    return count;
+  }
+
+  Token token() {
+    Token token;
+    token.type = static_cast<TokenType>(u8());
+    if (token.type > TokenType::END_OF_FILE) {
+      throw CorruptEntry();
+    }
+    token.line = i32();
+    uint8_t flags = u8();
+    if (flags & 1) {
+      uint32_t offset = u32();
+      uint32_t size = u32();
+      if (offset > m_source.size() || size > m_source.size() - offset) {
+        throw CorruptEntry();
+      }
+      token.lexeme = m_source.substr(offset, size);
+    } else {
+      token.lexeme = m_texts.emplace_back(text());
+    }
+    if (flags & 2) {
+      token.symbol = internSymbol(token.lexeme);
+    }
+    return token;
+  }
+
+  LocalSlot slot() {
+    LocalSlot local;
+    uint8_t storage = u8();
+    if (storage > static_cast<uint8_t>(LocalSlot::Storage::ENVIRONMENT)) {
+      throw CorruptEntry();
+    }
+    local.storage = static_cast<LocalSlot::Storage>(storage);
+    local.depth = i32();
+    local.slot = i32();
+    return local;
+  }
+
+  ScopeLayout layout() {
+    ScopeLayout layout;
+    uint32_t size = count();
+    for (uint32_t i = 0; i < size; i++) {
+      layout.names.push_back(internSymbol(text()));
+    }
+    return layout;
+  }
+
+  Expr *expr() {
+    Tag tag = static_cast<Tag>(u8());
+    switch (tag) {
+    case Tag::NONE:
+      return nullptr;
+    case Tag::BINARY: {
+      const Expr &left = requireExpr();
+      Token op = token();
+      return create<BinaryExpr>(left, op, requireExpr());
+    }
+    case Tag::LOGICAL: {
+      const Expr &left = requireExpr();
+      Token op = token();
+      return create<LogicalExpr>(left, op, requireExpr());
+    }
+    case Tag::UNARY: {
+      Token op = token();
+      return create<UnaryExpr>(op, requireExpr());
+    }
+    case Tag::LITERAL:
+      return literal();
+    case Tag::GROUPING:
+      return create<GroupingExpr>(requireExpr());
+    case Tag::VARIABLE: {
+      auto *variable = create<VariableExpr>(token());
+      variable->local = slot();
+      return variable;
+    }
+    case Tag::ASSIGN: {
+      Token name = token();
+      auto *assign = create<AssignExpr>(name, requireExpr());
+      assign->local = slot();
+      return assign;
+    }
+    case Tag::CALL: {
+      const Expr &callee = requireExpr();
+      Token paren = token();
+      std::vector<Expr *> arguments(count());
+      for (Expr *&argument : arguments) {
+        argument = &const_cast<Expr &>(requireExpr());
+      }
+      return create<CallExpr>(callee, paren, arguments);
+    }
+    case Tag::GET: {
+      const Expr &object = requireExpr();
+      return create<GetExpr>(object, token());
+    }
+    case Tag::SET: {
+      const Expr &object = requireExpr();
+      Token name = token();
+      return create<SetExpr>(object, name, requireExpr());
+    }
+    case Tag::THIS: {
+      auto *self = create<ThisExpr>(token());
+      self->local = slot();
+      return self;
+    }
+    case Tag::SUPER: {
+      Token keyword = token();
+      Token method = token();
+      auto *super = create<SuperExpr>(keyword, method);
+      super->local = slot();
+      super->receiver = slot();
+      return super;
+    }
+    default:
+      throw CorruptEntry();
+    }
+  }
+
+  const Expr &requireExpr() {
+    Expr *expr = this->expr();
+    if (!expr) {
+      throw CorruptEntry();
+    }
+    return *expr;
+  }
+
+  Stmt *stmt() {
+    Tag tag = static_cast<Tag>(u8());
+    switch (tag) {
+    case Tag::NONE:
+      return nullptr;
+    case Tag::EXPRESSION_STMT:
+      return create<ExpressionStmt>(requireExpr());
+    case Tag::PRINT_STMT:
+      return create<PrintStmt>(requireExpr());
+    case Tag::VAR_STMT: {
+      Token name = token();
+      auto *var = create<VarStmt>(name, expr());
+      var->local = slot();
+      return var;
+    }
+    case Tag::WHILE_STMT: {
+      const Expr &condition = requireExpr();
+      const Stmt &body = requireStmt();
+      return create<WhileStmt>(condition, body, stmt());
+    }
+    case Tag::BLOCK_STMT: {
+      auto *block = create<BlockStmt>(statements());
+      block->layout = layout();
+      block->hasScope = u8();
+      block->frame = layout();
+      return block;
+    }
+    case Tag::IF_STMT: {
+      const Expr &condition = requireExpr();
+      const Stmt &thenBranch = requireStmt();
+      return create<IfStmt>(condition, thenBranch, stmt());
+    }
+    case Tag::BREAK_STMT:
+      return create<BreakStmt>(token());
+    case Tag::CONTINUE_STMT:
+      return create<ContinueStmt>(token());
+    case Tag::CLASS_STMT: {
+      Token name = token();
+      const VariableExpr *superclass = nullptr;
+      if (Expr *expr = this->expr()) {
+        superclass = dynamic_cast<const VariableExpr *>(expr);
+        if (!superclass) {
+          throw CorruptEntry();
+        }
+      }
+      std::vector<FunctionStmt *> methods(count());
+      for (FunctionStmt *&method : methods) {
+        method = dynamic_cast<FunctionStmt *>(stmt());
+        if (!method) {
+          throw CorruptEntry();
+        }
+      }
+      auto *klass = create<ClassStmt>(name, std::move(methods), superclass);
+      klass->local = slot();
+      return klass;
+    }
+    case Tag::FUNCTION_STMT:
+      return function();
+    case Tag::RETURN_STMT: {
+      Token keyword = token();
+      return create<ReturnStmt>(keyword, expr());
+    }
+    default:
+      throw CorruptEntry();
+    }
+  }
+
+  const Stmt &requireStmt() {
+    Stmt *stmt = this->stmt();
+    if (!stmt) {
+      throw CorruptEntry();
+    }
+    return *stmt;
+  }
+
+  std::vector<Stmt *> statements() {
+    std::vector<Stmt *> statements(count());
+    for (Stmt *&statement : statements) {
+      statement = &const_cast<Stmt &>(requireStmt());
+    }
+    return statements;
+  }
+
+private:
+  void need(size_t bytes) const {
+    if (static_cast<size_t>(m_end - m_next) < bytes) {
+      throw CorruptEntry();
+    }
+  }
+
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    return m_arena.create<T>(std::forward<Args>(args)...);
+  }
+
+  Expr *literal() {
+    switch (static_cast<ValueType>(u8())) {
+    case ValueType::OBJ:
+      return create<LiteralExpr>(m_strings.add(std::string(text())));
+    case ValueType::NUMBER:
+      return create<LiteralExpr>(Value(std::bit_cast<double>(u64())));
+    case ValueType::BOOL:
+      return create<LiteralExpr>(Value(u8() != 0));
+    case ValueType::NIL:
+      return create<LiteralExpr>();
+    default:
+      throw CorruptEntry();
+    }
+  }
+
+  FunctionStmt *function() {
+    Token name = token();
+    uint32_t arity = count();
+    std::vector<Token> params;
+    std::vector<LocalSlot> parameters;
+    for (uint32_t i = 0; i < arity; i++) {
+      params.push_back(token());
+      parameters.push_back(slot());
+    }
+    auto *function = create<FunctionStmt>(name, params, statements());
+    function->parameters = std::move(parameters);
+    function->local = slot();
+    function->receiver = slot();
+    function->frame = layout();
+    function->layout = layout();
+    function->hasScope = u8();
+    return function;
+  }
+
+  const char *m_next;
+  const char *m_end;
+  std::string_view m_source;
+  Arena &m_arena;
+  std::deque<std::string> &m_texts;
+  LiteralStrings &m_strings;
+};
+
+// Checks that every slot of a loaded program indexes storage the engines will
+// have when it runs: globals the entry names, the frame of the enclosing
+// function (or top-level block), or an Environment the enclosing scopes
+// create. Environments are filled in declaration order, so a declaration must
+// also take the next slot of its scope's own Environment. And since the
+// engines take `super` to be a class and its receiver an instance without
+// checking, those must be the very variables the Resolver bound. The Resolver
+// only produces such programs; anything else is a damaged or edited entry.
+class SlotChecker : public ExprVisitor<void>, public StmtVisitor<void> {
+public:
+  explicit SlotChecker(size_t globalCount) : m_globalCount(globalCount) {}
+
+  void statements(const std::vector<Stmt *> &statements) {
+    bool inList = std::exchange(m_inList, true);
+    for (const Stmt *statement : statements) {
+      statement->accept(*this);
+    }
+    m_inList = inList;
+  }
+
+  void visitBinaryExpr(const BinaryExpr &expr) override {
+    expr.left.accept(*this);
+    expr.right.accept(*this);
+  }
+
+  void visitLogicalExpr(const LogicalExpr &expr) override {
+    expr.left.accept(*this);
+    expr.right.accept(*this);
+  }
+
+  void visitUnaryExpr(const UnaryExpr &expr) override {
+    expr.right.accept(*this);
+  }
+
+  void visitLiteralExpr(const LiteralExpr &expr) override {}
+
+  void visitGroupingExpr(const GroupingExpr &expr) override {
+    expr.expr.accept(*this);
+  }
+
+  void visitVariableExpr(const VariableExpr &expr) override { use(expr.local); }
+
+  void visitAssignExpr(const AssignExpr &expr) override {
+    expr.value.accept(*this);
+    use(expr.local);
+  }
+
+  void visitCallExpr(const CallExpr &expr) override {
+    expr.callee.accept(*this);
+    for (const Expr *argument : expr.arguments) {
+      argument->accept(*this);
+    }
+  }
+
+  void visitGetExpr(const GetExpr &expr) override { expr.object.accept(*this); }
+
+  void visitSetExpr(const SetExpr &expr) override {
+    expr.object.accept(*this);
+    expr.value.accept(*this);
+  }
+
+  void visitThisExpr(const ThisExpr &expr) override { use(expr.local); }
+
+  void visitSuperExpr(const SuperExpr &expr) override {
+    use(expr.local);
+    use(expr.receiver);
+    // A global `super` is reported when it runs
+    if ((!expr.local.isGlobal() && !isSuper(expr.local)) ||
+        !isReceiver(expr.receiver)) {
+      throw CorruptEntry();
+    }
+  }
+
+  void visitExpressionStmt(const ExpressionStmt &stmt) override {
+    stmt.expression.accept(*this);
+  }
+
+  void visitPrintStmt(const PrintStmt &stmt) override {
+    stmt.expression.accept(*this);
+  }
+
+  void visitVarStmt(const VarStmt &stmt) override {
+    if (stmt.initializer) {
+      stmt.initializer->accept(*this);
+    }
+    declare(stmt.local);
+  }
+
+  void visitWhileStmt(const WhileStmt &stmt) override {
+    bool inList = std::exchange(m_inList, false);
+    stmt.condition.accept(*this);
+    stmt.body.accept(*this);
+    if (stmt.increment) {
+      stmt.increment->accept(*this);
+    }
+    m_inList = inList;
+  }
+
+  void visitBlockStmt(const BlockStmt &stmt) override {
+    // Only the outermost block of top-level code has a frame of its own
+    size_t frameSize = m_frameSize;
+    size_t frame = m_frame;
+    if (!stmt.frame.names.empty()) {
+      if (m_frame != 0 || stmt.frame.names.size() > kFrameMax) {
+        throw CorruptEntry();
+      }
+      m_frameSize = stmt.frame.names.size();
+      m_frame = ++m_frameCount;
+    }
+    bool hasEnvironment = enterScope(stmt.hasScope, stmt.layout);
+    statements(stmt.statements);
+    leaveScope(stmt.hasScope, hasEnvironment);
+    m_frameSize = frameSize;
+    m_frame = frame;
+  }
+
+  void visitIfStmt(const IfStmt &stmt) override {
+    bool inList = std::exchange(m_inList, false);
+    stmt.condition.accept(*this);
+    stmt.thenBranch.accept(*this);
+    if (stmt.elseBranch) {
+      stmt.elseBranch->accept(*this);
+    }
+    m_inList = inList;
+  }
+
+  void visitBreakStmt(const BreakStmt &stmt) override {}
+
+  void visitContinueStmt(const ContinueStmt &stmt) override {}
+
+  void visitClassStmt(const ClassStmt &stmt) override {
+    if (stmt.superclass) {
+      stmt.superclass->accept(*this);
+      // Methods close over a scope holding just `super`, already defined
+      m_environments.push_back({1, 1, true});
+    }
+    for (const FunctionStmt *method : stmt.methods) {
+      function(*method, true);
+    }
+    if (stmt.superclass) {
+      m_environments.pop_back();
+    }
+    declare(stmt.local);
+  }
+
+  void visitFunctionStmt(const FunctionStmt &stmt) override {
+    function(stmt, false);
+    declare(stmt.local);
+  }
+
+  void visitReturnStmt(const ReturnStmt &stmt) override {
+    if (stmt.value) {
+      stmt.value->accept(*this);
+    }
+  }
+
+private:
+  struct Scope {
+    size_t size;
+    size_t defined;          // Slots its declarations have taken so far
+    bool holdsSuper = false; // The scope a subclass's methods close over
+  };
+
+  // Where the innermost method's receiver lives: a slot of frame `owner`, or
+  // of m_environments[owner]
+  struct Receiver {
+    bool inFrame;
+    size_t owner;
+    int slot;
+  };
+
+  void function(const FunctionStmt &stmt, bool isMethod) {
+    if (stmt.frame.names.size() > kFrameMax) {
+      throw CorruptEntry();
+    }
+    size_t frameSize = std::exchange(m_frameSize, stmt.frame.names.size());
+    size_t frame = std::exchange(m_frame, ++m_frameCount);
+    std::optional<Receiver> receiver = m_receiver;
+    bool inList = std::exchange(m_inList, true);
+    bool hasEnvironment = enterScope(stmt.hasScope, stmt.layout);
+    // The receiver and parameters are bound before the body runs
+    if (isMethod) {
+      declare(stmt.receiver);
+      m_receiver.reset();
+      if (stmt.receiver.isFrame()) {
+        m_receiver = Receiver{true, m_frame, stmt.receiver.slot};
+      } else if (!stmt.receiver.isGlobal()) {
+        m_receiver = Receiver{false, m_environments.size() - 1,
+                              stmt.receiver.slot};
+      }
+    }
+    for (LocalSlot parameter : stmt.parameters) {
+      declare(parameter);
+    }
+    statements(stmt.body);
+    leaveScope(stmt.hasScope, hasEnvironment);
+    m_frameSize = frameSize;
+    m_frame = frame;
+    m_receiver = receiver;
+    m_inList = inList;
+  }
+
+  bool enterScope(bool hasScope, const ScopeLayout &layout) {
+    if (hasScope) {
+      m_environments.push_back({layout.names.size(), 0});
+    }
+    return std::exchange(m_hasEnvironment, hasScope);
+  }
+
+  void leaveScope(bool hasScope, bool hasEnvironment) {
+    if (hasScope) {
+      m_environments.pop_back();
+    }
+    m_hasEnvironment = hasEnvironment;
+  }
+
+  void use(LocalSlot local) {
+    if (local.slot < 0) {
+      throw CorruptEntry();
+    }
+    size_t slot = static_cast<size_t>(local.slot);
+    switch (local.storage) {
+    case LocalSlot::Storage::GLOBAL:
+      if (slot >= m_globalCount) {
+        throw CorruptEntry();
+      }
+      return;
+    case LocalSlot::Storage::FRAME:
+      if (slot >= m_frameSize) {
+        throw CorruptEntry();
+      }
+      return;
+    case LocalSlot::Storage::ENVIRONMENT:
+      if (local.depth < 0 ||
+          static_cast<size_t>(local.depth) >= m_environments.size() ||
+          slot >= m_environments[environmentOf(local)].size) {
+        throw CorruptEntry();
+      }
+      return;
+    }
+  }
+
+  // The Environment an ENVIRONMENT slot that use() accepted refers to
+  size_t environmentOf(LocalSlot local) const {
+    return m_environments.size() - 1 - local.depth;
+  }
+
+  bool isSuper(LocalSlot local) const {
+    return local.storage == LocalSlot::Storage::ENVIRONMENT &&
+           m_environments[environmentOf(local)].holdsSuper;
+  }
+
+  bool isReceiver(LocalSlot local) const {
+    if (!m_receiver || local.slot != m_receiver->slot) {
+      return false;
+    }
+    if (local.isFrame()) {
+      return m_receiver->inFrame && m_receiver->owner == m_frame;
+    }
+    return local.storage == LocalSlot::Storage::ENVIRONMENT &&
+           !m_receiver->inFrame && m_receiver->owner == environmentOf(local);
+  }
+
+  // A captured variable takes the next slot of the Environment its own scope
+  // created, which the scope must enter just once per Environment: not from
+  // a loop body or branch that isn't a block.
+  void declare(LocalSlot local) {
+    if (local.storage != LocalSlot::Storage::ENVIRONMENT) {
+      use(local);
+      return;
+    }
+    if (!m_hasEnvironment || !m_inList || local.depth != 0) {
+      throw CorruptEntry();
+    }
+    Scope &scope = m_environments.back();
+    if (local.slot < 0 || static_cast<size_t>(local.slot) != scope.defined ||
+        scope.defined == scope.size) {
+      throw CorruptEntry();
+    }
+    scope.defined++;
+  }
+
+  size_t m_globalCount;
+  size_t m_frameSize = 0; // Top-level code outside blocks has no frame
+  size_t m_frame = 0;     // Numbers the current frame, 0 for none
+  size_t m_frameCount = 0;
+  std::optional<Receiver> m_receiver;
+  std::vector<Scope> m_environments; // Innermost last
+  bool m_hasEnvironment = false; // The current scope created the innermost
+  bool m_inList = true;          // The statement is in a statement list
+};
+
+} // namespace
+
+bool ProgramCache::load(std::string_view source, GlobalTable &globals,
+                        std::vector<Stmt *> &statements) {
+  MappedFile file;
+  if (!file.open(pathFor(source))) {
+    return false;
+  }
+
+  // Everything before the trailing checksum must hash to it. That catches
+  // most damage cheaply but not an edited entry, so the program is checked
+  // as well (see SlotChecker) before anything runs it.
+  std::string_view contents = file.contents();
+  if (contents.size() < 8) {
+    return false;
+  }
+  std::string_view body = contents.substr(0, contents.size() - 8);
+  uint64_t checksum = 0;
+  for (int i = 0; i < 8; i++) {
+    checksum |= static_cast<uint64_t>(static_cast<uint8_t>(
+                    contents[body.size() + i]))
+                << (8 * i);
+  }
+  if (hashBytes(body) != checksum) {
+    return false;
+  }
+
+  Reader reader(body, source, m_arena, m_texts, m_strings);
+  try {
+    for (char c : kMagic) {
+      if (reader.u8() != static_cast<uint8_t>(c)) {
+        return false;
+      }
+    }
+    // Entries are named by a weak hash, so the whole source is compared
+    if (reader.u32() != kFormatVersion || reader.text() != source) {
+      return false;
+    }
+
+    GlobalTable loaded;
+    uint32_t globalCount = reader.count();
+    for (uint32_t i = 0; i < globalCount; i++) {
+      loaded.indexOf(internSymbol(reader.text()));
+    }
+    std::vector<Stmt *> program = reader.statements();
+    if (!reader.atEnd()) {
+      return false;
+    }
+    SlotChecker(loaded.size()).statements(program);
+    globals = std::move(loaded);
+    statements = std::move(program);
+    return true;
+  } catch (const CorruptEntry &) {
+    return false;
+  }
+}
+
+void ProgramCache::store(std::string_view source, const GlobalTable &globals,
+                         const std::vector<Stmt *> &statements) {
+  Writer writer(source);
+  for (char c : kMagic) {
+    writer.u8(static_cast<uint8_t>(c));
+  }
+  writer.u32(kFormatVersion);
+  writer.text(source);
+  writer.u32(static_cast<uint32_t>(globals.size()));
+  for (uint32_t index = 0; index < globals.size(); index++) {
+    writer.text(symbolName(globals.nameAt(index)));
+  }
+  writer.statements(statements);
+  writer.u64(hashBytes(writer.out()));
+
+  // Written under a unique name and renamed into place, so a concurrent run
+  // never sees a partial entry.
+  std::error_code error;
+  std::filesystem::create_directories(m_directory, error);
+  std::string path = pathFor(source);
+  std::string temporary = path + "." + std::to_string(std::random_device{}()) +
+                          ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.write(writer.out().data(),
+                    static_cast<std::streamsize>(writer.out().size()))) {
+      file.close();
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+#pragma once
+
+#include "Arena.hpp"
+#include "Expr.hpp"
+#include "GlobalTable.hpp"
+#include "Stmt.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * On-disk cache of resolved programs (`--cache-dir`), so that running an
+ * unchanged script skips the Scanner, Parser and Resolver.
+ *
+ * Each entry is a `<hash>.loxc` file named after a hash of the source. It
+ * holds a version header, a copy of the source, the program's global names in
+ * GlobalTable order, the AST with everything the Resolver recorded on it, and
+ * a checksum of all of that. Tokens refer to the source by offset, so a
+ * loaded program points into the same source text it was cached for, just as
+ * a parsed one does.
+ *
+ * A missing, stale or damaged entry is simply a miss, as is one whose slots
+ * don't fit the globals, frames and scopes the program would run with.
+ */
+class ProgramCache {
+public:
+  explicit ProgramCache(std::string directory)
+      : m_directory(std::move(directory)) {}
+
+  // Loads the program cached for `source` into `statements`, numbering its
+  // globals in `globals` (which must be empty). The program points into
+  // `source` and into this cache, which must both outlive it.
+  bool load(std::string_view source, GlobalTable &globals,
+            std::vector<Stmt *> &statements);
+
+  // Caches a program that resolved without errors. Failures are ignored:
+  // the next run just parses again.
+  void store(std::string_view source, const GlobalTable &globals,
+             const std::vector<Stmt *> &statements);
+
+private:
+  std::string pathFor(std::string_view source) const;
+
+  std::string m_directory;
+  Arena m_arena;                   // Owns loaded nodes
+  std::deque<std::string> m_texts; // Lexemes that aren't in the source
+  LiteralStrings m_strings;        // Loaded string literals
+};
+
+#endif // PROGRAM_CACHE_H_
@@ -3,7 +3,7 @@
 #pragma once
 
 #include "Expr.hpp"
-#include "Interpreter.h"
+#include "GlobalTable.hpp"
 #include "Stmt.hpp"
 #include "dataStruct.hpp"
 #include <vector>
@@ -35,13 +35,51 @@ private:
 
   enum class VariableState { DECLARED, DEFINED, USED };
 
-  // Store the variable state and the token for error reporting
-  using Scope =
-      std::unordered_map<std::string, std::pair<VariableState, Token>>;
+  // A reference to a local, which can only be bound once the variable's
+  // scope ends and it is known whether a closure captures it
+  struct Use {
+    LocalSlot *site;
+    int scope; // The scope the reference is in (see ScopeInfo)
+  };
+
+  // Store the variable state, the token for error reporting, and what's
+  // needed to place the variable when its scope ends
+  struct Variable {
+    VariableState state;
+    Token token;
+    int index;              // Order of declaration within the scope
+    LocalSlot *declaration; // Set for statements that define the variable
+    bool captured = false;  // Referenced from a nested function
+    std::vector<Use> uses;
+  };
+  struct Scope {
+    std::unordered_map<Symbol, Variable> variables;
+    int id; // Index into m_scopeInfo
+  };
   IndexableStack<Scope> scopes{};
 
+  // Every scope resolved so far, kept after it ends so that the number of
+  // Environments between a reference and its variable can be counted.
+  struct ScopeInfo {
+    int parent;   // -1 for an outermost scope
+    int function; // The function (or top-level block) the scope belongs to
+    bool hasEnvironment = false;
+  };
+  std::vector<ScopeInfo> m_scopeInfo;
+
+  // Functions being resolved, innermost last, with the frame slots each has
+  // handed out so far. A block in top-level code counts as one.
+  struct FunctionFrame {
+    int id;
+    ScopeLayout slots;
+  };
+  std::vector<FunctionFrame> m_frames;
+  int m_functionCount = 0;
+
 public:
-  explicit Resolver(Interpreter &interpreter) : m_interpreter(interpreter) {}
+  // Global names get their indices in `globals`, which the Interpreter that
+  // runs the program must share.
+  explicit Resolver(GlobalTable &globals) : m_globals(globals) {}
 
   void resolve(const std::vector<Stmt *> &statements) {
     for (Stmt *statement : statements)
@@ -53,13 +91,23 @@ public:
   void resolve(const Expr *const expr) { expr->accept(*this); }
 
   void visitBlockStmt(const BlockStmt &stmt) override {
+    // Locals of top-level code live in the frame of the outermost block
+    bool ownsFrame = m_frames.empty();
+    if (ownsFrame) {
+      m_frames.push_back({m_functionCount++});
+    }
     beginScope();
     resolve(stmt.statements);
-    endScope();
+    stmt.layout = endScope();
+    stmt.hasScope = !stmt.layout.names.empty();
+    if (ownsFrame) {
+      stmt.frame = std::move(m_frames.back().slots);
+      m_frames.pop_back();
+    }
   }
 
   void visitVarStmt(const VarStmt &stmt) override {
-    declare(stmt.name);
+    declare(stmt.name, &stmt.local);
     if (stmt.initializer)
       resolve(stmt.initializer);
     define(stmt.name);
@@ -67,30 +115,31 @@ public:
 
   void visitVariableExpr(const VariableExpr &expr) override {
     if (!scopes.empty()) {
-      auto it = scopes.top().find(expr.name.lexeme);
-      if (it != scopes.top().end() &&
-          it->second.first == VariableState::DECLARED) {
+      auto &variables = scopes.top().variables;
+      auto it = variables.find(expr.name.symbol);
+      if (it != variables.end() &&
+          it->second.state == VariableState::DECLARED) {
         lox::error(expr.name,
                    "Can't read local variable in its own initializer.");
       }
     }
-    resolveLocal(expr, expr.name, true);
+    resolveLocal(expr.local, expr.name, true);
   }
 
   void visitAssignExpr(const AssignExpr &expr) override {
     resolve(&expr.value);
-    resolveLocal(expr, expr.name, false);
+    resolveLocal(expr.local, expr.name, false);
   }
 
   void visitClassStmt(const ClassStmt &stmt) override {
     ClassType enclosingClass = currentClass;
     currentClass = ClassType::CLASS;
 
-    declare(stmt.name);
+    declare(stmt.name, &stmt.local);
     define(stmt.name);
 
     if (stmt.superclass) {
-      if (stmt.name.lexeme == stmt.superclass->name.lexeme) {
+      if (stmt.name.symbol == stmt.superclass->name.symbol) {
         lox::error(stmt.superclass->name, "A class can't inherit from itself.");
       }
       currentClass = ClassType::SUBCLASS;
@@ -99,26 +148,23 @@ public:
 
     if (stmt.superclass) {
       beginScope();
-      Token superToken(TokenType::SUPER, "super", stmt.name.line);
-      declare(superToken);
+      Token superToken(TokenType::SUPER, "super", stmt.name.line,
+                       internSymbol("super"));
+      declare(superToken, nullptr);
       define(superToken);
-      // avoid unused 'super' warning
-      scopes.top()[superToken.lexeme].first = VariableState::USED;
+      // avoid unused 'super' warning. The methods are the only users, so it
+      // always lives in an Environment (see Interpreter::visitClassStmt).
+      Variable &super = scopes.top().variables.at(superToken.symbol);
+      super.state = VariableState::USED;
+      super.captured = true;
     }
 
-    beginScope();
-    Token thisToken(TokenType::THIS, "this", stmt.name.line);
-    declare(thisToken);
-    define(thisToken);
-    // avoid unused 'this' warning
-    scopes.top()[thisToken.lexeme].first = VariableState::USED;
     for (const FunctionStmt *method : stmt.methods) {
       FunctionType declaration = method->name.lexeme == "init"
                                      ? FunctionType::INITIALIZER
                                      : FunctionType::METHOD;
       resolveFunction(*method, declaration);
     }
-    endScope();
     if (stmt.superclass) {
       endScope();
     }
@@ -126,7 +172,7 @@ public:
   }
 
   void visitFunctionStmt(const FunctionStmt &stmt) override {
-    declare(stmt.name);
+    declare(stmt.name, &stmt.local);
     define(stmt.name);
     resolveFunction(stmt, FunctionType::FUNCTION);
   }
@@ -188,7 +234,7 @@ public:
       lox::error(expr.keyword, "Can't use 'this' outside of a class.");
       return;
     }
-    resolveLocal(expr, expr.keyword, true);
+    resolveLocal(expr.local, expr.keyword, true);
   }
 
   void visitSuperExpr(const SuperExpr &expr) override {
@@ -197,8 +243,12 @@ public:
     } else if (currentClass != ClassType::SUBCLASS) {
       lox::error(expr.keyword, "Can't use 'super' in a class with no "
                                "superclass.");
+    } else {
+      Token thisToken(TokenType::THIS, "this", expr.keyword.line,
+                      internSymbol("this"));
+      resolveLocal(expr.receiver, thisToken, true);
     }
-    resolveLocal(expr, expr.keyword, true);
+    resolveLocal(expr.local, expr.keyword, true);
   }
 
   void visitGroupingExpr(const GroupingExpr &expr) override {
@@ -231,77 +281,159 @@ public:
   }
 
 private:
-  void beginScope() { scopes.push(Scope()); }
+  void beginScope() {
+    int parent = scopes.empty() ? -1 : scopes.top().id;
+    int function = m_frames.empty() ? -1 : m_frames.back().id;
+    scopes.push(Scope{{}, static_cast<int>(m_scopeInfo.size())});
+    m_scopeInfo.push_back({parent, function});
+  }
 
-  void endScope() {
-    Scope scope = scopes.top();
+  // Places the scope's variables now that all their uses are known, and
+  // binds every use. Returns the layout of the scope's Environment, which it
+  // only needs if some variable is captured.
+  ScopeLayout endScope() {
+    Scope scope = std::move(scopes.top());
     scopes.pop();
 
-    for (const auto &[name, state_token_pair] : scope) {
-      if (state_token_pair.first != VariableState::USED) {
-        lox::error(state_token_pair.second,
-                   "Local variable '" + name + "' is defined but never used.");
+    std::vector<Variable *> variables(scope.variables.size());
+    for (auto &[symbol, variable] : scope.variables) {
+      if (variable.state != VariableState::USED) {
+        lox::error(variable.token,
+                   "Local variable '" + std::string(variable.token.lexeme) +
+                       "' is defined but never used.");
       }
+      variables[variable.index] = &variable;
     }
+
+    ScopeLayout layout;
+    for (Variable *variable : variables) {
+      LocalSlot local;
+      if (variable->captured) {
+        local = {LocalSlot::Storage::ENVIRONMENT, 0,
+                 static_cast<int>(layout.names.size())};
+        layout.names.push_back(variable->token.symbol);
+      } else {
+        std::vector<Symbol> &frame = m_frames.back().slots.names;
+        if (frame.size() == static_cast<size_t>(kFrameMax)) {
+          lox::error(variable->token, "Too many local variables in function.");
+        }
+        local = {LocalSlot::Storage::FRAME, 0, static_cast<int>(frame.size())};
+        frame.push_back(variable->token.symbol);
+      }
+      if (variable->declaration) {
+        *variable->declaration = local;
+      }
+      for (const Use &use : variable->uses) {
+        *use.site = local;
+        if (variable->captured) {
+          use.site->depth = environmentsBetween(use.scope, scope.id);
+        }
+      }
+    }
+    m_scopeInfo[scope.id].hasEnvironment = !layout.names.empty();
+    return layout;
   }
 
-  void declare(const Token &name) {
-    if (scopes.empty())
+  // How many Environments enclose scope `inner` inside scope `outer`. Only
+  // called once every scope in between has ended.
+  int environmentsBetween(int inner, int outer) const {
+    int count = 0;
+    for (int id = inner; id != outer; id = m_scopeInfo[id].parent) {
+      count += m_scopeInfo[id].hasEnvironment;
+    }
+    return count;
+  }
+
+  // `declaration` is where the declaring statement expects to be told where
+  // the variable lives.
+  void declare(const Token &name, LocalSlot *declaration) {
+    if (scopes.empty()) {
+      if (declaration) {
+        *declaration = {LocalSlot::Storage::GLOBAL, 0,
+                        static_cast<int>(m_globals.indexOf(name.symbol))};
+      }
       return;
+    }
 
-    Scope &current_scope = scopes.top();
-    if (current_scope.count(name.lexeme)) {
+    auto &variables = scopes.top().variables;
+    if (variables.count(name.symbol)) {
       lox::error(name, "Already a variable with this name in this scope.");
     }
-    current_scope.emplace(name.lexeme,
-                          std::make_pair(VariableState::DECLARED, name));
+    int index = static_cast<int>(variables.size());
+    variables.emplace(name.symbol, Variable{VariableState::DECLARED, name,
+                                            index, declaration});
   }
 
   void define(const Token &name) {
     if (scopes.empty())
       return;
-    scopes.top()[name.lexeme].first = VariableState::DEFINED;
+    scopes.top().variables.at(name.symbol).state = VariableState::DEFINED;
   }
 
   // Added 'isRead' parameter to distinguish variable access (read) from
   // assignment target resolution
-  void resolveLocal(const Expr &expr, const Token &name, bool isRead) {
+  void resolveLocal(LocalSlot &local, const Token &name, bool isRead) {
     for (int i = scopes.size() - 1; i >= 0; i--) {
       Scope &scope = scopes.get(i); // Get mutable reference
-      if (scope.contains(name.lexeme)) {
-        m_interpreter.resolve(expr, scopes.size() - 1 - i);
+      auto it = scope.variables.find(name.symbol);
+      if (it != scope.variables.end()) {
+        Variable &variable = it->second;
+        // Bound in endScope, once it's known where the variable lives
+        variable.uses.push_back({&local, scopes.top().id});
+        if (m_scopeInfo[scope.id].function !=
+            m_scopeInfo[scopes.top().id].function) {
+          variable.captured = true;
+        }
         // Mark as used only if it's being read, not just assigned to
         if (isRead) {
-          scope[name.lexeme].first = VariableState::USED;
+          variable.state = VariableState::USED;
         }
         return;
       }
     }
     // If not found in local scopes, assume global (resolution error handled
     // elsewhere if needed)
+    local = {LocalSlot::Storage::GLOBAL, 0,
+             static_cast<int>(m_globals.indexOf(name.symbol))};
   }
 
   void resolveFunction(const FunctionStmt &function, FunctionType type) {
     FunctionType enclosingFunction = currentFunction;
     currentFunction = type;
+    m_frames.push_back({m_functionCount++});
     beginScope();
-    for (const Token &param : function.params) {
-      declare(param);
+    // A method's receiver is the first variable of its own scope, so calling
+    // one doesn't need a separate scope holding `this`.
+    if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER) {
+      Token thisToken(TokenType::THIS, "this", function.name.line,
+                      internSymbol("this"));
+      declare(thisToken, &function.receiver);
+      define(thisToken);
+      // avoid unused 'this' warning
+      scopes.top().variables.at(thisToken.symbol).state = VariableState::USED;
+    }
+    function.parameters.resize(function.params.size());
+    for (size_t i = 0; i < function.params.size(); i++) {
+      const Token &param = function.params[i];
+      declare(param, &function.parameters[i]);
       define(param);
       // Parameters are implicitly used if the function is called,
       // but we can mark them USED immediately to avoid unused errors
-      scopes.top()[param.lexeme].first = VariableState::USED;
+      scopes.top().variables.at(param.symbol).state = VariableState::USED;
     }
     resolve(function.body);
-    endScope();
+    function.layout = endScope();
+    function.hasScope = !function.layout.names.empty();
+    function.frame = std::move(m_frames.back().slots);
+    m_frames.pop_back();
     currentFunction = enclosingFunction;
   }
 
 private:
-  Interpreter &m_interpreter;
   FunctionType currentFunction = FunctionType::NONE;
   ClassType currentClass = ClassType::NONE;
   int m_loop_depth = 0; // Track loop nesting level
+  GlobalTable &m_globals;
 };
 
 #endif // RESOLVER_H_
@@ -0,0 +1,235 @@
+#include "ScanKernels.h"
+#include <bit>
+#include <cstdint>
+
+#if !defined(LOX_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define LOX_SCAN_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define LOX_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+namespace scan {
+namespace {
+
+bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Matches std::isalnum in the "C" locale, plus '_'
+bool isIdentifier(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// Newlines among the bits of `newlines` below bit `at`
+int linesBefore(uint32_t newlines, int at) {
+  return std::popcount(newlines & ((uint32_t{1} << at) - 1));
+}
+
+// Scalar kernels, which also finish off what the vector ones leave over
+
+const char *findScalar(const char *p, const char *end, char target,
+                       int &lines) {
+  for (; p < end && *p != target; p++) {
+    lines += *p == '\n';
+  }
+  return p;
+}
+
+const char *skipBlanksScalar(const char *p, const char *end, int &lines) {
+  for (; p < end && isBlank(*p); p++) {
+    lines += *p == '\n';
+  }
+  return p;
+}
+
+const char *skipIdentifierScalar(const char *p, const char *end) {
+  while (p < end && isIdentifier(*p)) {
+    p++;
+  }
+  return p;
+}
+
+#ifdef LOX_SCAN_SSE2
+
+// Bytes of `chunk` in [lo, hi]. The compares are signed, so bytes >= 0x80
+// are never in range.
+__m128i inRange(__m128i chunk, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(lo - 1)),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), chunk));
+}
+
+uint32_t mask(__m128i matches) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+}
+
+const char *findSse2(const char *p, const char *end, char target,
+                     int &lines) {
+  const __m128i wanted = _mm_set1_epi8(target);
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    uint32_t found = mask(_mm_cmpeq_epi8(chunk, wanted));
+    uint32_t newlines = mask(_mm_cmpeq_epi8(chunk, newline));
+    if (found) {
+      int at = std::countr_zero(found);
+      lines += linesBefore(newlines, at);
+      return p + at;
+    }
+    lines += std::popcount(newlines);
+  }
+  return findScalar(p, end, target, lines);
+}
+
+const char *skipBlanksSse2(const char *p, const char *end, int &lines) {
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+    __m128i blank = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), newline));
+    uint32_t stops = ~mask(blank) & 0xffff;
+    if (stops) {
+      int at = std::countr_zero(stops);
+      lines += linesBefore(mask(newline), at);
+      return p + at;
+    }
+    lines += std::popcount(mask(newline));
+  }
+  return skipBlanksScalar(p, end, lines);
+}
+
+const char *skipIdentifierSse2(const char *p, const char *end) {
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    // Setting 0x20 folds upper case onto lower case and leaves digits be
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i identifier = _mm_or_si128(
+        _mm_or_si128(inRange(folded, 'a', 'z'), inRange(chunk, '0', '9')),
+        _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+    uint32_t stops = ~mask(identifier) & 0xffff;
+    if (stops) {
+      return p + std::countr_zero(stops);
+    }
+  }
+  return skipIdentifierScalar(p, end);
+}
+
+#endif // LOX_SCAN_SSE2
+
+#ifdef LOX_SCAN_AVX2
+
+// The same kernels as above, 32 bytes at a time
+
+#define LOX_AVX2 __attribute__((target("avx2")))
+
+LOX_AVX2 __m256i inRange(__m256i chunk, char lo, char hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), chunk));
+}
+
+LOX_AVX2 uint32_t mask(__m256i matches) {
+  return static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+}
+
+LOX_AVX2 const char *findAvx2(const char *p, const char *end, char target,
+                              int &lines) {
+  const __m256i wanted = _mm256_set1_epi8(target);
+  const __m256i newline = _mm256_set1_epi8('\n');
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    uint32_t found = mask(_mm256_cmpeq_epi8(chunk, wanted));
+    uint32_t newlines = mask(_mm256_cmpeq_epi8(chunk, newline));
+    if (found) {
+      int at = std::countr_zero(found);
+      lines += linesBefore(newlines, at);
+      return p + at;
+    }
+    lines += std::popcount(newlines);
+  }
+  return findSse2(p, end, target, lines);
+}
+
+LOX_AVX2 const char *skipBlanksAvx2(const char *p, const char *end,
+                                    int &lines) {
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i newline = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+    __m256i blank = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')),
+                        newline));
+    uint32_t stops = ~mask(blank);
+    if (stops) {
+      int at = std::countr_zero(stops);
+      lines += linesBefore(mask(newline), at);
+      return p + at;
+    }
+    lines += std::popcount(mask(newline));
+  }
+  return skipBlanksSse2(p, end, lines);
+}
+
+LOX_AVX2 const char *skipIdentifierAvx2(const char *p, const char *end) {
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i folded = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    __m256i identifier = _mm256_or_si256(
+        _mm256_or_si256(inRange(folded, 'a', 'z'), inRange(chunk, '0', '9')),
+        _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')));
+    uint32_t stops = ~mask(identifier);
+    if (stops) {
+      return p + std::countr_zero(stops);
+    }
+  }
+  return skipIdentifierSse2(p, end);
+}
+
+#undef LOX_AVX2
+
+#endif // LOX_SCAN_AVX2
+
+struct Kernels {
+  const char *(*find)(const char *, const char *, char, int &);
+  const char *(*skipBlanks)(const char *, const char *, int &);
+  const char *(*skipIdentifier)(const char *, const char *);
+};
+
+Kernels choose() {
+#ifdef LOX_SCAN_AVX2
+  // Needed when this runs before main, as it does here
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {findAvx2, skipBlanksAvx2, skipIdentifierAvx2};
+  }
+#endif
+#ifdef LOX_SCAN_SSE2
+  return {findSse2, skipBlanksSse2, skipIdentifierSse2};
+#else
+  return {findScalar, skipBlanksScalar, skipIdentifierScalar};
+#endif
+}
+
+// Chosen during static initialization, so calls needn't check a guard
+const Kernels kernels = choose();
+
+} // namespace
+
+const char *find(const char *p, const char *end, char target, int &lines) {
+  return kernels.find(p, end, target, lines);
+}
+
+const char *skipBlanks(const char *p, const char *end, int &lines) {
+  return kernels.skipBlanks(p, end, lines);
+}
+
+const char *skipIdentifier(const char *p, const char *end) {
+  return kernels.skipIdentifier(p, end);
+}
+
+} // namespace scan
@@ -0,0 +1,29 @@
+#ifndef SCAN_KERNELS_H_
+#define SCAN_KERNELS_H_
+#pragma once
+
+/**
+ * Byte-run searches behind the Scanner's hot loops: blanks between tokens,
+ * identifiers, comments and string literals.
+ *
+ * Each takes the half-open range [p, end) and returns where the run stops,
+ * adding any newlines it steps over to `lines`. On x86-64 they look at 16
+ * (SSE2) or, where the CPU has it, 32 (AVX2) bytes per step; the choice is
+ * made once, during static initialization at startup. Elsewhere, or when
+ * built with LOX_NO_SIMD, they go a byte at a time. Nothing is ever read at
+ * or past `end`.
+ */
+namespace scan {
+
+// The first `target` byte, or `end`.
+const char *find(const char *p, const char *end, char target, int &lines);
+
+// The first byte that isn't a space, tab, carriage return or newline.
+const char *skipBlanks(const char *p, const char *end, int &lines);
+
+// The first byte that can't continue an identifier ([A-Za-z0-9_]).
+const char *skipIdentifier(const char *p, const char *end);
+
+} // namespace scan
+
+#endif // SCAN_KERNELS_H_
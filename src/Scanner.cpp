@@ -1,11 +1,12 @@
 #include "Scanner.h"
+#include "ScanKernels.h"
 #include "error.h"
 #include <fmt/core.h>
-#include <map>
+#include <vector>
 
 using lox::error;
 
-std::map<string, TokenType> keywords = {
+static const std::pair<std::string_view, TokenType> keywords[] = {
     {"and", TokenType::AND},       {"class", TokenType::CLASS},
     {"else", TokenType::ELSE},     {"false", TokenType::FALSE},
     {"fun", TokenType::FUN},       {"for", TokenType::FOR},
@@ -17,20 +18,42 @@ std::map<string, TokenType> keywords = {
     {"break", TokenType::BREAK},   {"continue", TokenType::CONTINUE},
 };
 
-Scanner::Scanner(const string &source) : m_source(source) {}
+// Keywords are scanned like identifiers; this maps each keyword's symbol to
+// its token type and every other symbol to IDENTIFIER.
+static TokenType identifierType(Symbol symbol) {
+  static const std::vector<TokenType> types = [] {
+    std::vector<TokenType> types;
+    for (const auto &[name, type] : keywords) {
+      Symbol keyword = internSymbol(name);
+      if (keyword >= types.size())
+        types.resize(keyword + 1, TokenType::IDENTIFIER);
+      types[keyword] = type;
+    }
+    return types;
+  }();
+  return symbol < types.size() ? types[symbol] : TokenType::IDENTIFIER;
+}
+
+Scanner::Scanner(std::string_view source, int line)
+    : m_source(source), m_line(line) {}
 
-vector<Token> Scanner::scanTokens() {
-  while (!isAtEnd()) {
+Token Scanner::nextToken() {
+  // Blanks, comments and bad characters produce no token
+  m_hasToken = false;
+  while (!m_hasToken && !isAtEnd()) {
     m_start = m_current;
     scanToken();
   }
-  m_tokens.push_back(Token(TokenType::END_OF_FILE, "", m_line));
-  return m_tokens;
+  if (!m_hasToken) {
+    return Token(TokenType::END_OF_FILE, "", m_line);
+  }
+  return m_token;
 }
 
-void Scanner::addToken(TokenType type) {
-  string text = m_source.substr(m_start, m_current - m_start);
-  m_tokens.push_back({.type = type, .lexeme = text, .line = m_line});
+void Scanner::addToken(TokenType type, Symbol symbol) {
+  std::string_view text = m_source.substr(m_start, m_current - m_start);
+  m_token = {.type = type, .lexeme = text, .line = m_line, .symbol = symbol};
+  m_hasToken = true;
 }
 
 bool Scanner::isAtEnd() const { return m_current >= m_source.size(); }
@@ -46,6 +69,16 @@ char Scanner::advance() {
   return m_source[m_current++];
 }
 
+const char *Scanner::cursor() const { return m_source.data() + m_current; }
+
+const char *Scanner::sourceEnd() const {
+  return m_source.data() + m_source.size();
+}
+
+void Scanner::skipTo(const char *position) {
+  m_current = static_cast<int>(position - m_source.data());
+}
+
 void Scanner::scanToken() {
   char c = advance();
   switch (c) {
@@ -105,29 +138,20 @@ void Scanner::scanToken() {
     break;
   case '/':
     if (peek() == '/') {
-      advance();
-      while (peek() != '\n' && !isAtEnd())
-        advance();
+      // The newline is left to end the comment and be counted below
+      int lines = 0;
+      skipTo(scan::find(cursor(), sourceEnd(), '\n', lines));
     } else if (peek() == '*') {
       advance();
-      while (peek() != '*' && peek(1) != '/' && !isAtEnd()) {
-        if (peek() == '\n')
-          m_line++;
-        advance();
-      }
-      if (isAtEnd())
-        error(m_line, "Unterminated comment.");
-      advance();
-      advance();
+      handleBlockComment();
     } else
       addToken(TokenType::SLASH);
     break;
   case ' ':
   case '\r':
   case '\t':
-    break;
   case '\n':
-    m_line++;
+    skipTo(scan::skipBlanks(cursor() - 1, sourceEnd(), m_line));
     break;
   case '"':
     handleString();
@@ -143,12 +167,24 @@ void Scanner::scanToken() {
   }
 }
 
-void Scanner::handleString() {
-  while (peek() != '"' && !isAtEnd()) {
-    if (peek() == '\n')
-      m_line++;
+void Scanner::handleBlockComment() {
+  // Each '*' that isn't followed by '/' is stepped over
+  while (true) {
+    skipTo(scan::find(cursor(), sourceEnd(), '*', m_line));
+    if (isAtEnd()) {
+      error(m_line, "Unterminated comment.");
+      return;
+    }
     advance();
+    if (peek() == '/') {
+      advance();
+      return;
+    }
   }
+}
+
+void Scanner::handleString() {
+  skipTo(scan::find(cursor(), sourceEnd(), '"', m_line));
   if (isAtEnd()) {
     error(m_line, "Unterminated string.");
     return;
@@ -171,11 +207,7 @@ void Scanner::handleNumber() {
 }
 
 void Scanner::handleIdentifier() {
-  while (std::isalnum(peek()) || peek() == '_')
-    advance();
-  string text = m_source.substr(m_start, m_current - m_start);
-  if (keywords.find(text) != keywords.end())
-    addToken(keywords.at(text));
-  else
-    addToken(TokenType::IDENTIFIER);
+  skipTo(scan::skipIdentifier(cursor(), sourceEnd()));
+  Symbol symbol = internSymbol(m_source.substr(m_start, m_current - m_start));
+  addToken(identifierType(symbol), symbol);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "Token.h"
 
@@ -10,22 +11,33 @@ using std::vector;
 
 class Scanner {
 public:
-  [[nodiscard]] explicit Scanner(const string &source);
-  vector<Token> scanTokens();
+  // Tokens point into `source`, which must outlive them. `line` is the line
+  // `source` starts on, for scanning part of a larger text.
+  [[nodiscard]] explicit Scanner(std::string_view source, int line = 1);
+  // Scans as far as the next token and returns it; once the source is used
+  // up, every call returns END_OF_FILE.
+  Token nextToken();
 
 private:
   bool isAtEnd() const;
   char advance();
   char peek(const int offset = 0) const;
+  // Where scanning has got to, and the end of the source, for the runs that
+  // the scan:: kernels skip in bulk
+  const char *cursor() const;
+  const char *sourceEnd() const;
+  void skipTo(const char *position);
   void scanToken();
-  void addToken(TokenType);
+  void addToken(TokenType, Symbol symbol = kNoSymbol);
+  void handleBlockComment();
   void handleString();
   void handleNumber();
   void handleIdentifier();
 
 private:
-  string m_source;
-  vector<Token> m_tokens;
+  std::string_view m_source;
+  Token m_token{};          // Set by addToken
+  bool m_hasToken = false; // Whether scanToken() produced m_token
   int m_start = 0;
   int m_current = 0;
   int m_line = 1;
@@ -0,0 +1,93 @@
+#ifndef SHAPE_H_
+#define SHAPE_H_
+#pragma once
+
+#include "Symbol.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+class LoxFunction;
+
+/**
+ * Hidden class describing which fields an instance has and where each one
+ * lives in its slot array.
+ *
+ * Every class has a root shape with no fields. Adding a field moves an
+ * instance to the child shape for that field, so instances that gained the
+ * same fields in the same order share a shape, and a property site that has
+ * seen a shape before knows the slot without any lookup.
+ *
+ * A class owns its root shape (children are owned by their parent) and
+ * frees the tree when it is collected. Caches therefore hold a shape's id,
+ * which is never reused, rather than its address, which may be.
+ */
+class Shape {
+public:
+  Shape() : id(nextId()) {}
+
+
+  // Slot of field `name`, or -1 if instances of this shape don't have it
+  int slotOf(Symbol name) const {
+    auto it = m_slots.find(name);
+    return it != m_slots.end() ? it->second : -1;
+  }
+
+  // The shape of an instance of this shape after adding field `name`
+  Shape *withField(Symbol name) {
+    std::unique_ptr<Shape> &next = m_transitions[name];
+    if (!next) {
+      next = std::make_unique<Shape>();
+      next->m_slots = m_slots;
+      next->m_slots.emplace(name, static_cast<int>(m_slots.size()));
+    }
+    return next.get();
+  }
+
+  const uint64_t id;
+
+private:
+  static uint64_t nextId() {
+    static uint64_t next = 0;
+    return next++;
+  }
+
+  std::unordered_map<Symbol, int> m_slots;
+  std::unordered_map<Symbol, std::unique_ptr<Shape>> m_transitions;
+};
+
+/**
+ * Polymorphic inline cache kept by each property access site. Each entry
+ * remembers what the site did for one receiver shape.
+ */
+struct PropertyCache {
+  static constexpr int kMaxEntries = 4;
+
+  struct Entry {
+    uint64_t shape;      // Id of the receiver's shape
+    int slot;            // Field slot, or -1 when the property is a method
+    Shape *next;         // Set: the receiver's shape after the store
+    LoxFunction *method; // Get: the method found instead of a field
+  };
+
+  const Entry *find(const Shape *shape) const {
+    for (int i = 0; i < count; i++) {
+      if (entries[i].shape == shape->id) {
+        return &entries[i];
+      }
+    }
+    return nullptr;
+  }
+
+  // Once full the site is megamorphic and keeps using the slow path.
+  void add(const Entry &entry) {
+    if (count < kMaxEntries) {
+      entries[count++] = entry;
+    }
+  }
+
+  Entry entries[kMaxEntries];
+  int count = 0;
+};
+
+#endif // SHAPE_H_
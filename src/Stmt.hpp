@@ -6,6 +6,14 @@
 #include "Token.h"
 #include <vector>
 
+/**
+ * The variables a local scope declares, in slot order. Computed once by the
+ * Resolver and shared by every Environment created for that scope.
+ */
+struct ScopeLayout {
+  std::vector<Symbol> names;
+};
+
 // Forward declarations of all statement types we'll need
 class ExpressionStmt;
 class ClassStmt;
@@ -21,7 +29,7 @@ class ReturnStmt;
 
 /**
  * The visitor pattern for statements. Unlike expressions which can return
- * different types (string for printing, LiteralValue for interpreting),
+ * different types (string for printing, Value for interpreting),
  * statements are executed solely for their side effects, so they don't
  * return anything.
  */
@@ -105,6 +113,7 @@ public:
   const Token name; // The name of the variable being declared
   const Expr
       *initializer; // The initializer expression, or nullptr if not initialized
+  mutable LocalSlot local; // Set by the Resolver
 };
 
 class WhileStmt : public Stmt {
@@ -140,6 +149,13 @@ public:
   }
 
   const std::vector<Stmt *> statements;
+  // Set by the Resolver. A block gets an Environment only if closures
+  // capture some of its variables (`hasScope`); the rest live in the stack
+  // frame of the enclosing call. Outside any function, the outermost block
+  // holds the frame itself (`frame` names its slots, empty otherwise).
+  mutable ScopeLayout layout;
+  mutable bool hasScope = true;
+  mutable ScopeLayout frame;
 };
 
 class IfStmt : public Stmt {
@@ -196,6 +212,7 @@ public:
   const Token name;
   const VariableExpr *superclass;
   const std::vector<FunctionStmt *> methods;
+  mutable LocalSlot local; // Set by the Resolver
 };
 
 class FunctionStmt : public Stmt {
@@ -211,6 +228,15 @@ public:
   const Token name;
   const std::vector<Token> params;
   const std::vector<Stmt *> body;
+  // Set by the Resolver: where the declared name, the receiver (methods
+  // only) and each parameter live, the slots of a call's stack frame, and
+  // the layout of the Environment for its captured locals, if it needs one.
+  mutable LocalSlot local;
+  mutable LocalSlot receiver;
+  mutable std::vector<LocalSlot> parameters;
+  mutable ScopeLayout frame;
+  mutable ScopeLayout layout;
+  mutable bool hasScope = true;
 };
 
 class ReturnStmt : public Stmt {
@@ -0,0 +1,94 @@
+#include "Symbol.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Symbols may be interned from several threads at once (see ParallelParser).
+// Names are spread over independently locked shards by hash, so threads
+// rarely wait on each other, while IDs still come from one dense sequence.
+static constexpr size_t kShards = 64;
+// Names are looked up by ID in segments that never move once allocated, so
+// symbolName() takes no lock.
+static constexpr int kSegmentBits = 16;
+static constexpr size_t kSegmentSize = size_t{1} << kSegmentBits;
+static constexpr size_t kSegments = size_t{1} << (32 - kSegmentBits);
+
+// A name with its hash, which picks the shard and then serves the shard's
+// map without being computed again
+struct HashedName {
+  std::string_view name;
+  size_t hash;
+
+  bool operator==(const HashedName &other) const { return name == other.name; }
+};
+
+struct HashedNameHash {
+  size_t operator()(const HashedName &key) const { return key.hash; }
+};
+
+struct SymbolShard {
+  std::mutex lock;
+  std::deque<std::string> storage; // Never relocates the strings it holds
+  std::unordered_map<HashedName, Symbol, HashedNameHash> ids;
+};
+
+struct SymbolTable {
+  ~SymbolTable() {
+    for (auto &segment : segments) {
+      delete[] segment.load(std::memory_order_relaxed);
+    }
+  }
+
+  // The slot for `symbol`'s name, allocating its segment if need be
+  std::string_view &slot(Symbol symbol) {
+    std::atomic<std::string_view *> &segment = segments[symbol >> kSegmentBits];
+    std::string_view *names = segment.load(std::memory_order_acquire);
+    if (!names) {
+      auto *fresh = new std::string_view[kSegmentSize];
+      if (segment.compare_exchange_strong(names, fresh,
+                                          std::memory_order_acq_rel)) {
+        names = fresh;
+      } else {
+        delete[] fresh; // Another thread got there first
+      }
+    }
+    return names[symbol & (kSegmentSize - 1)];
+  }
+
+  std::array<SymbolShard, kShards> shards;
+  std::array<std::atomic<std::string_view *>, kSegments> segments{};
+  std::atomic<Symbol> next{0};
+};
+
+// Constructed on first use so that other static initializers may intern.
+static SymbolTable &table() {
+  static SymbolTable table;
+  return table;
+}
+
+Symbol internSymbol(std::string_view name) {
+  SymbolTable &symbols = table();
+  HashedName key{name, std::hash<std::string_view>{}(name)};
+  SymbolShard &shard = symbols.shards[key.hash % kShards];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  auto it = shard.ids.find(key);
+  if (it != shard.ids.end()) {
+    return it->second;
+  }
+  std::string_view stored = shard.storage.emplace_back(name);
+  Symbol symbol = symbols.next.fetch_add(1, std::memory_order_relaxed);
+  symbols.slot(symbol) = stored;
+  shard.ids.emplace(HashedName{stored, key.hash}, symbol);
+  return symbol;
+}
+
+std::string_view symbolName(Symbol symbol) {
+  // Whoever handed out `symbol` is ordered after its slot was written: by
+  // the shard lock, or by however the threads synchronised since.
+  std::string_view *names = table().segments[symbol >> kSegmentBits].load(
+      std::memory_order_acquire);
+  return names[symbol & (kSegmentSize - 1)];
+}
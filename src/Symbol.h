@@ -0,0 +1,27 @@
+#ifndef SYMBOL_H_
+#define SYMBOL_H_
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Process-wide interned identifier.
+ *
+ * The Scanner interns every identifier (and keyword) once, so the rest of the
+ * pipeline can key scopes, environments, fields and methods by a 32-bit ID
+ * instead of hashing and comparing the name's characters.
+ */
+using Symbol = uint32_t;
+
+// Carried by tokens that aren't identifiers or keywords
+inline constexpr Symbol kNoSymbol = UINT32_MAX;
+
+// Returns the symbol for `name`, the same one every time it's asked for.
+Symbol internSymbol(std::string_view name);
+
+// The characters of an interned symbol. The view stays valid for the life of
+// the process.
+std::string_view symbolName(Symbol symbol);
+
+#endif // SYMBOL_H_
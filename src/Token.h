@@ -2,12 +2,15 @@
 #define TOKEN_H_
 #pragma once
 
+#include <cstdint>
 #include <fmt/core.h>
 #include <string>
+#include <string_view>
+#include "Symbol.h"
 
 using std::string;
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   // Single-character tokens.
   LEFT_PAREN,
   RIGHT_PAREN,
@@ -61,10 +64,13 @@ enum class TokenType {
 
 std::string tokenTypeToString(TokenType type);
 
+// A token refers to its text in the source buffer rather than owning a copy,
+// so the source must outlive every token (and AST node) scanned from it.
 struct Token {
   TokenType type;
-  string lexeme;
+  std::string_view lexeme;
   int line;
+  Symbol symbol = kNoSymbol; // Identifiers and keywords only
 
   inline string toString() const {
     return fmt::format("{} {}", tokenTypeToString(type), lexeme);
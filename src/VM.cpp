@@ -0,0 +1,551 @@
+#include "VM.h"
+#include "Compiler.h"
+#include "EnvironmentPrinter.h"
+#include "error.h"
+#include <chrono>
+#include <iostream>
+
+static Value clockNative(VM &vm, int argCount, Value *args) {
+  // Same resolution as the tree-walker's clock(): whole seconds.
+  auto now = std::chrono::system_clock::now();
+  auto seconds = std::chrono::time_point_cast<std::chrono::seconds>(now);
+  return static_cast<double>(seconds.time_since_epoch().count());
+}
+
+static Value printEnvNative(VM &vm, int argCount, Value *args) {
+  std::cout << vm.globalsToString() << std::endl;
+  return nullptr;
+}
+
+VM::VM(HeapConfig heapConfig)
+    : m_heap(*this, heapConfig),
+      m_stack(static_cast<Value *>(::operator new(kStackMax * sizeof(Value)))),
+      m_frames(kFramesMax) {
+  resetStack();
+  m_initString = m_heap.intern(std::string_view("init"));
+  defineNative("clock", 0, clockNative);
+  defineNative("__printEnv", 0, printEnvNative);
+}
+
+void VM::interpret(const std::vector<Stmt *> &statements) {
+  Compiler compiler(*this);
+  ObjFunction *function = compiler.compile(statements);
+  if (function == nullptr)
+    return;
+
+  push(function);
+  ObjClosure *closure = m_heap.allocate<ObjClosure>(function);
+  pop();
+  push(closure);
+
+  try {
+    call(closure, 0);
+    run();
+  } catch (const RuntimeError &error) {
+    std::cout.flush();
+    lox::error(error.m_token, error.what(), true);
+    resetStack();
+  }
+}
+
+size_t VM::globalSlot(Symbol name) {
+  auto it = m_globalSlots.find(name);
+  if (it != m_globalSlots.end())
+    return it->second;
+
+  ObjString *interned = m_heap.intern(symbolName(name));
+  m_globalNames.push_back(interned);
+  m_globals.push_back(Value::empty());
+  m_globalSlots.emplace(name, m_globals.size() - 1);
+  return m_globals.size() - 1;
+}
+
+std::string VM::globalsToString() const {
+  std::vector<std::pair<std::string, std::string>> rows;
+  for (size_t i = 0; i < m_globals.size(); i++) {
+    if (!m_globals[i].isEmpty()) {
+      rows.emplace_back(m_globalNames[i]->chars, valueToString(m_globals[i]));
+    }
+  }
+  return formatScope(0, this, rows);
+}
+
+void VM::markRoots(Heap &heap) {
+  for (Value *slot = m_stack.get(); slot < m_stackTop; slot++) {
+    heap.markValue(*slot);
+  }
+  for (int i = 0; i < m_frameCount; i++) {
+    heap.markObject(m_frames[i].closure);
+  }
+  for (ObjUpvalue *upvalue = m_openUpvalues; upvalue != nullptr;
+       upvalue = upvalue->nextOpen) {
+    heap.markObject(upvalue);
+  }
+  for (Value global : m_globals) {
+    heap.markValue(global);
+  }
+  for (ObjString *name : m_globalNames) {
+    heap.markObject(name);
+  }
+  heap.markObject(m_initString);
+}
+
+void VM::resetStack() {
+  m_stackTop = m_stack.get();
+  m_frameCount = 0;
+  m_openUpvalues = nullptr;
+}
+
+void VM::run() {
+  CallFrame *frame = &m_frames[m_frameCount - 1];
+  uint8_t *ip = frame->ip;
+
+  auto readByte = [&]() { return *ip++; };
+  auto readShort = [&]() {
+    ip += 2;
+    return static_cast<uint16_t>((ip[-2] << 8) | ip[-1]);
+  };
+  auto readLong = [&]() {
+    ip += 3;
+    return static_cast<uint32_t>((ip[-3] << 16) | (ip[-2] << 8) | ip[-1]);
+  };
+  auto constant = [&](uint32_t index) {
+    return frame->closure->function->chunk.constants[index];
+  };
+  auto readString = [&]() {
+    return static_cast<ObjString *>(constant(readLong()).asObj());
+  };
+  auto error = [&](const std::string &message) {
+    frame->ip = ip;
+    runtimeError(message);
+  };
+  auto getGlobal = [&](uint32_t slot) {
+    Value value = m_globals[slot];
+    if (value.isEmpty()) {
+      error("Undefined variable '" + m_globalNames[slot]->chars + "'.");
+    }
+    push(value);
+  };
+  auto setGlobal = [&](uint32_t slot) {
+    if (m_globals[slot].isEmpty()) {
+      error("Undefined variable '" + m_globalNames[slot]->chars + "'.");
+    }
+    m_globals[slot] = peek(0);
+  };
+  auto numberOperands = [&]() {
+    if (!peek(0).isNumber() || !peek(1).isNumber())
+      error("Operands must be numbers.");
+    double b = pop().asNumber();
+    double a = pop().asNumber();
+    return std::make_pair(a, b);
+  };
+
+  while (true) {
+    switch (static_cast<OpCode>(readByte())) {
+    case OpCode::CONSTANT:
+      push(constant(readShort()));
+      break;
+    case OpCode::CONSTANT_LONG:
+      push(constant(readLong()));
+      break;
+    case OpCode::NIL:
+      push(nullptr);
+      break;
+    case OpCode::TRUE:
+      push(true);
+      break;
+    case OpCode::FALSE:
+      push(false);
+      break;
+    case OpCode::POP:
+      pop();
+      break;
+    case OpCode::GET_LOCAL:
+      push(frame->slots[readByte()]);
+      break;
+    case OpCode::GET_LOCAL_LONG:
+      push(frame->slots[readLong()]);
+      break;
+    case OpCode::SET_LOCAL:
+      frame->slots[readByte()] = peek(0);
+      break;
+    case OpCode::SET_LOCAL_LONG:
+      frame->slots[readLong()] = peek(0);
+      break;
+    case OpCode::GET_GLOBAL:
+      getGlobal(readShort());
+      break;
+    case OpCode::GET_GLOBAL_LONG:
+      getGlobal(readLong());
+      break;
+    case OpCode::DEFINE_GLOBAL:
+      m_globals[readShort()] = pop();
+      break;
+    case OpCode::DEFINE_GLOBAL_LONG:
+      m_globals[readLong()] = pop();
+      break;
+    case OpCode::SET_GLOBAL:
+      setGlobal(readShort());
+      break;
+    case OpCode::SET_GLOBAL_LONG:
+      setGlobal(readLong());
+      break;
+    case OpCode::GET_UPVALUE:
+      push(*frame->closure->upvalues[readByte()]->location);
+      break;
+    case OpCode::GET_UPVALUE_LONG:
+      push(*frame->closure->upvalues[readLong()]->location);
+      break;
+    case OpCode::SET_UPVALUE:
+      *frame->closure->upvalues[readByte()]->location = peek(0);
+      break;
+    case OpCode::SET_UPVALUE_LONG:
+      *frame->closure->upvalues[readLong()]->location = peek(0);
+      break;
+    case OpCode::GET_PROPERTY: {
+      ObjString *name = readString();
+      if (!isObjType(peek(0), ObjType::INSTANCE)) {
+        error("Only instances have properties.");
+      }
+      auto *instance = static_cast<ObjInstance *>(peek(0).asObj());
+      auto it = instance->fields.find(name);
+      if (it != instance->fields.end()) {
+        m_stackTop[-1] = it->second;
+        break;
+      }
+      frame->ip = ip;
+      bindMethod(instance->klass, name);
+      break;
+    }
+    case OpCode::SET_PROPERTY: {
+      ObjString *name = readString();
+      if (!isObjType(peek(1), ObjType::INSTANCE)) {
+        error("Only instances have fields.");
+      }
+      auto *instance = static_cast<ObjInstance *>(peek(1).asObj());
+      size_t fieldCount = instance->fields.size();
+      instance->fields[name] = peek(0);
+      if (instance->fields.size() != fieldCount) {
+        m_heap.resized(instance);
+      }
+      Value value = pop();
+      m_stackTop[-1] = value;
+      break;
+    }
+    case OpCode::GET_SUPER: {
+      ObjString *name = readString();
+      auto *superclass = static_cast<ObjClass *>(pop().asObj());
+      frame->ip = ip;
+      bindMethod(superclass, name);
+      break;
+    }
+    case OpCode::EQUAL: {
+      Value b = pop();
+      m_stackTop[-1] = valuesEqual(m_stackTop[-1], b);
+      break;
+    }
+    case OpCode::NOT_EQUAL: {
+      Value b = pop();
+      m_stackTop[-1] = !valuesEqual(m_stackTop[-1], b);
+      break;
+    }
+    case OpCode::GREATER: {
+      auto [a, b] = numberOperands();
+      push(a > b);
+      break;
+    }
+    case OpCode::GREATER_EQUAL: {
+      auto [a, b] = numberOperands();
+      push(a >= b);
+      break;
+    }
+    case OpCode::LESS: {
+      auto [a, b] = numberOperands();
+      push(a < b);
+      break;
+    }
+    case OpCode::LESS_EQUAL: {
+      auto [a, b] = numberOperands();
+      push(a <= b);
+      break;
+    }
+    case OpCode::ADD: {
+      Value b = peek(0);
+      Value a = peek(1);
+      if (a.isNumber() && b.isNumber()) {
+        m_stackTop -= 2;
+        push(a.asNumber() + b.asNumber());
+      } else if (isObjType(a, ObjType::STRING) &&
+                 isObjType(b, ObjType::STRING)) {
+        // Both operands stay on the stack while the result is allocated.
+        ObjString *result =
+            m_heap.intern(static_cast<ObjString *>(a.asObj())->chars +
+                          static_cast<ObjString *>(b.asObj())->chars);
+        m_stackTop -= 2;
+        push(result);
+      } else {
+        error("Operands must be two numbers or two strings.");
+      }
+      break;
+    }
+    case OpCode::SUBTRACT: {
+      auto [a, b] = numberOperands();
+      push(a - b);
+      break;
+    }
+    case OpCode::MULTIPLY: {
+      auto [a, b] = numberOperands();
+      push(a * b);
+      break;
+    }
+    case OpCode::DIVIDE: {
+      auto [a, b] = numberOperands();
+      if (b == 0) {
+        error("Division by zero.");
+      }
+      push(a / b);
+      break;
+    }
+    case OpCode::NOT:
+      m_stackTop[-1] = m_stackTop[-1].isFalsey();
+      break;
+    case OpCode::NEGATE:
+      if (!peek(0).isNumber()) {
+        error("Operand must be a number.");
+      }
+      m_stackTop[-1] = -m_stackTop[-1].asNumber();
+      break;
+    case OpCode::PRINT:
+      std::cout << valueToString(pop()) << '\n';
+      break;
+    case OpCode::JUMP: {
+      uint32_t offset = readLong();
+      ip += offset;
+      break;
+    }
+    case OpCode::JUMP_IF_FALSE: {
+      uint32_t offset = readLong();
+      if (peek(0).isFalsey())
+        ip += offset;
+      break;
+    }
+    case OpCode::LOOP: {
+      uint32_t offset = readLong();
+      ip -= offset;
+      break;
+    }
+    case OpCode::CALL: {
+      int argCount = readByte();
+      frame->ip = ip;
+      callValue(peek(argCount), argCount);
+      frame = &m_frames[m_frameCount - 1];
+      ip = frame->ip;
+      break;
+    }
+    case OpCode::INVOKE: {
+      ObjString *name = readString();
+      frame->ip = ip; // Not past the argument count: errors at the name
+      int argCount = readByte();
+      invoke(name, argCount);
+      frame = &m_frames[m_frameCount - 1];
+      ip = frame->ip;
+      break;
+    }
+    case OpCode::CLOSURE: {
+      auto *function = static_cast<ObjFunction *>(constant(readLong()).asObj());
+      ObjClosure *closure = m_heap.allocate<ObjClosure>(function);
+      push(closure);
+      for (int i = 0; i < function->upvalueCount; i++) {
+        uint8_t isLocal = readByte();
+        uint32_t index = readLong();
+        closure->upvalues[i] = isLocal ? captureUpvalue(frame->slots + index)
+                                       : frame->closure->upvalues[index];
+      }
+      break;
+    }
+    case OpCode::CLOSE_UPVALUE:
+      closeUpvalues(m_stackTop - 1);
+      pop();
+      break;
+    case OpCode::RETURN: {
+      Value result = pop();
+      closeUpvalues(frame->slots);
+      m_frameCount--;
+      if (m_frameCount == 0) {
+        pop();
+        return;
+      }
+      m_stackTop = frame->slots;
+      push(result);
+      frame = &m_frames[m_frameCount - 1];
+      ip = frame->ip;
+      break;
+    }
+    case OpCode::CLASS:
+      push(m_heap.allocate<ObjClass>(readString()));
+      break;
+    case OpCode::INHERIT: {
+      if (!isObjType(peek(1), ObjType::CLASS)) {
+        error("Superclass must be a class.");
+      }
+      auto *superclass = static_cast<ObjClass *>(peek(1).asObj());
+      auto *subclass = static_cast<ObjClass *>(peek(0).asObj());
+      // Copy-down inheritance: classes are closed once their body runs.
+      subclass->methods = superclass->methods;
+      subclass->initializer = superclass->initializer;
+      m_heap.resized(subclass);
+      pop();
+      break;
+    }
+    case OpCode::METHOD: {
+      ObjString *name = readString();
+      auto *method = static_cast<ObjClosure *>(peek(0).asObj());
+      auto *klass = static_cast<ObjClass *>(peek(1).asObj());
+      klass->methods[name] = method;
+      m_heap.resized(klass);
+      if (name == m_initString)
+        klass->initializer = method;
+      pop();
+      break;
+    }
+    }
+  }
+}
+
+void VM::callValue(Value callee, int argCount) {
+  if (callee.isObj()) {
+    switch (callee.asObj()->type) {
+    case ObjType::BOUND_METHOD: {
+      auto *bound = static_cast<ObjBoundMethod *>(callee.asObj());
+      m_stackTop[-argCount - 1] = bound->receiver;
+      call(bound->method, argCount);
+      return;
+    }
+    case ObjType::CLASS: {
+      auto *klass = static_cast<ObjClass *>(callee.asObj());
+      m_stackTop[-argCount - 1] = m_heap.allocate<ObjInstance>(klass);
+      if (klass->initializer != nullptr) {
+        call(klass->initializer, argCount);
+      } else if (argCount != 0) {
+        runtimeError("Expected 0 arguments but got " +
+                     std::to_string(argCount) + ".");
+      }
+      return;
+    }
+    case ObjType::CLOSURE:
+      call(static_cast<ObjClosure *>(callee.asObj()), argCount);
+      return;
+    case ObjType::NATIVE: {
+      auto *native = static_cast<ObjNative *>(callee.asObj());
+      if (argCount != native->arity) {
+        runtimeError("Expected " + std::to_string(native->arity) +
+                     " arguments but got " + std::to_string(argCount) + ".");
+      }
+      Value result = native->function(*this, argCount, m_stackTop - argCount);
+      m_stackTop -= argCount + 1;
+      push(result);
+      return;
+    }
+    default:
+      break;
+    }
+  }
+  runtimeError("Can only call functions and classes.");
+}
+
+void VM::call(ObjClosure *closure, int argCount) {
+  if (argCount != closure->function->arity) {
+    runtimeError("Expected " + std::to_string(closure->function->arity) +
+                 " arguments but got " + std::to_string(argCount) + ".");
+  }
+  // Room for the callee's locals and its temporaries
+  Value *slots = m_stackTop - argCount - 1;
+  if (m_frameCount == kFramesMax ||
+      slots + closure->function->maxSlots + kFrameTemporaries >
+          m_stack.get() + kStackMax) {
+    runtimeError("Stack overflow.");
+  }
+
+  CallFrame &frame = m_frames[m_frameCount++];
+  frame.closure = closure;
+  frame.ip = closure->function->chunk.code.data();
+  frame.slots = slots;
+}
+
+void VM::invoke(ObjString *name, int argCount) {
+  CallFrame &frame = m_frames[m_frameCount - 1];
+  Value receiver = peek(argCount);
+  if (!isObjType(receiver, ObjType::INSTANCE)) {
+    runtimeError("Only instances have properties.");
+  }
+  auto *instance = static_cast<ObjInstance *>(receiver.asObj());
+
+  // A field holding a callable is called like any other value.
+  auto field = instance->fields.find(name);
+  if (field != instance->fields.end()) {
+    m_stackTop[-argCount - 1] = field->second;
+    frame.ip++;
+    callValue(field->second, argCount);
+    return;
+  }
+
+  auto method = instance->klass->methods.find(name);
+  if (method == instance->klass->methods.end()) {
+    runtimeError("Undefined property '" + name->chars + "'.");
+  }
+  // The receiver is already in slot 0 of the new frame.
+  frame.ip++;
+  call(method->second, argCount);
+}
+
+void VM::bindMethod(ObjClass *klass, ObjString *name) {
+  auto it = klass->methods.find(name);
+  if (it == klass->methods.end()) {
+    runtimeError("Undefined property '" + name->chars + "'.");
+  }
+  // The receiver stays on the stack while the bound method is allocated.
+  ObjBoundMethod *bound =
+      m_heap.allocate<ObjBoundMethod>(peek(0), it->second);
+  m_stackTop[-1] = bound;
+}
+
+ObjUpvalue *VM::captureUpvalue(Value *local) {
+  ObjUpvalue *previous = nullptr;
+  ObjUpvalue *upvalue = m_openUpvalues;
+  while (upvalue != nullptr && upvalue->location > local) {
+    previous = upvalue;
+    upvalue = upvalue->nextOpen;
+  }
+  if (upvalue != nullptr && upvalue->location == local)
+    return upvalue;
+
+  ObjUpvalue *created = m_heap.allocate<ObjUpvalue>(local);
+  created->nextOpen = upvalue;
+  if (previous == nullptr) {
+    m_openUpvalues = created;
+  } else {
+    previous->nextOpen = created;
+  }
+  return created;
+}
+
+void VM::closeUpvalues(Value *last) {
+  while (m_openUpvalues != nullptr && m_openUpvalues->location >= last) {
+    ObjUpvalue *upvalue = m_openUpvalues;
+    upvalue->closed = *upvalue->location;
+    upvalue->location = &upvalue->closed;
+    m_openUpvalues = upvalue->nextOpen;
+  }
+}
+
+void VM::defineNative(const std::string &name, int arity, NativeFn function) {
+  size_t slot = globalSlot(internSymbol(name));
+  m_globals[slot] = m_heap.allocate<ObjNative>(name, arity, function);
+}
+
+void VM::runtimeError(const std::string &message) {
+  const CallFrame &frame = m_frames[m_frameCount - 1];
+  const Chunk &chunk = frame.closure->function->chunk;
+  size_t offset = frame.ip - chunk.code.data();
+  throw RuntimeError(chunk.siteBefore(offset), message);
+}
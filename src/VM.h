@@ -0,0 +1,96 @@
+#ifndef VM_H_
+#define VM_H_
+#pragma once
+
+#include "Heap.h"
+#include "Object.h"
+#include "Stmt.hpp"
+#include "Value.h"
+#include "Symbol.h"
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Stack-based bytecode virtual machine.
+ *
+ * An alternative to the tree-walking Interpreter: the resolved program is
+ * lowered by the Compiler into bytecode chunks which are then executed by a
+ * single dispatch loop operating on a value stack.
+ */
+class VM : public Heap::RootSource {
+public:
+  explicit VM(HeapConfig heapConfig = {});
+
+  void interpret(const std::vector<Stmt *> &statements);
+
+  Heap &heap() { return m_heap; }
+
+  // Index of the global variable `name`, allocating a slot on first use.
+  // Globals are resolved to indices at compile time.
+  size_t globalSlot(Symbol name);
+
+  // Formats the global variables for the __printEnv native.
+  std::string globalsToString() const;
+
+  void markRoots(Heap &heap) override;
+
+private:
+  struct CallFrame {
+    ObjClosure *closure;
+    uint8_t *ip;
+    Value *slots;
+  };
+
+  // The Interpreter's kCallsMax, so every engine recurses equally deep
+  static constexpr int kFramesMax = 16 * 1024;
+  // Slots a call keeps free above its locals (ObjFunction::maxSlots) for
+  // arguments and other temporaries; the stack fits kFramesMax such frames
+  static constexpr int kFrameTemporaries = 256;
+  static constexpr int kStackMax = kFramesMax * kFrameTemporaries;
+
+  void run();
+
+  void push(Value value) { *m_stackTop++ = value; }
+  Value pop() { return *--m_stackTop; }
+  Value peek(int distance) const { return m_stackTop[-1 - distance]; }
+  void resetStack();
+
+  void callValue(Value callee, int argCount);
+  void call(ObjClosure *closure, int argCount);
+  // Calls property `name` of the receiver under the arguments. The frame's
+  // ip must point at the INVOKE's argument count.
+  void invoke(ObjString *name, int argCount);
+  void bindMethod(ObjClass *klass, ObjString *name);
+  ObjUpvalue *captureUpvalue(Value *local);
+  void closeUpvalues(Value *last);
+  void defineNative(const std::string &name, int arity, NativeFn function);
+
+  // Throws a RuntimeError located at the current instruction of the
+  // innermost frame. The frame's ip must be up to date.
+  [[noreturn]] void runtimeError(const std::string &message);
+
+  // Declared first so it outlives everything that points into it.
+  Heap m_heap;
+
+  // Left uninitialised: slots are written by push() before they're read,
+  // so pages are only touched as deep as the program actually recurses
+  struct FreeStack {
+    void operator()(Value *stack) const { ::operator delete(stack); }
+  };
+  std::unique_ptr<Value, FreeStack> m_stack;
+  Value *m_stackTop;
+  std::vector<CallFrame> m_frames;
+  int m_frameCount = 0;
+  ObjUpvalue *m_openUpvalues = nullptr;
+
+  std::vector<Value> m_globals; // Value::empty() until defined
+  std::vector<ObjString *> m_globalNames;
+  std::unordered_map<Symbol, size_t> m_globalSlots;
+
+  ObjString *m_initString = nullptr;
+};
+
+#endif // VM_H_
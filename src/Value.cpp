@@ -0,0 +1,52 @@
+#include "Value.h"
+#include "Object.h"
+#include <cstring>
+
+bool valuesEqual(Value a, Value b) {
+  if (a.type() != b.type())
+    return false;
+  switch (a.type()) {
+  case ValueType::NIL:
+  case ValueType::EMPTY:
+    return true;
+  case ValueType::BOOL:
+    return a.asBool() == b.asBool();
+  case ValueType::NUMBER:
+    return a.asNumber() == b.asNumber();
+  case ValueType::OBJ:
+    if (a.asObj() == b.asObj())
+      return true;
+    return isObjType(a, ObjType::STRING) && isObjType(b, ObjType::STRING) &&
+           static_cast<ObjString *>(a.asObj())->chars ==
+               static_cast<ObjString *>(b.asObj())->chars;
+  }
+  return false;
+}
+
+std::string formatNumber(double number) {
+  std::string s = std::to_string(number);
+  // trim trailing zeros
+  s.erase(s.find_last_not_of('0') + 1);
+  if (s.back() == '.') {
+    s.erase(s.size() - 1);
+  }
+  return s;
+}
+
+std::string valueToString(Value value) {
+  switch (value.type()) {
+  case ValueType::NIL:
+  case ValueType::EMPTY:
+    return "nil";
+  case ValueType::BOOL:
+    return value.asBool() ? "true" : "false";
+  case ValueType::NUMBER:
+    return formatNumber(value.asNumber());
+  case ValueType::OBJ:
+    if (isObjType(value, ObjType::STRING)) {
+      return "\"" + value.asObj()->toString() + "\"";
+    }
+    return value.asObj()->toString();
+  }
+  return "nil";
+}
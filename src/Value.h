@@ -0,0 +1,104 @@
+#ifndef VALUE_H_
+#define VALUE_H_
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Obj;
+
+enum class ValueType : uint8_t {
+  NIL,
+  BOOL,
+  NUMBER,
+  OBJ,
+  EMPTY, // Marks an unset slot (e.g. a declared but undefined global)
+};
+
+/**
+ * Compact runtime value shared by the tree-walker and the bytecode VM.
+ *
+ * A Value is a single NaN-boxed 64-bit word: any bit pattern that isn't one
+ * of the quiet NaNs reserved below is a plain double, and the reserved ones
+ * encode nil, the booleans, the empty marker, or (with the sign bit set) a
+ * pointer to a heap object. A Value owns nothing: objects are reclaimed by
+ * their Heap's collector, so copying a Value is copying a word.
+ */
+class Value {
+public:
+  constexpr Value() : m_bits(kQnan | kTagNil) {}
+  constexpr Value(std::nullptr_t) : Value() {}
+  constexpr Value(bool boolean)
+      : m_bits(kQnan | (boolean ? kTagTrue : kTagFalse)) {}
+  constexpr Value(double number) : m_bits(std::bit_cast<uint64_t>(number)) {}
+  Value(Obj *obj)
+      : m_bits(kSignBit | kQnan | reinterpret_cast<uintptr_t>(obj)) {}
+
+  static constexpr Value empty() { return fromBits(kQnan | kTagEmpty); }
+
+  ValueType type() const {
+    if (isNumber())
+      return ValueType::NUMBER;
+    if (isObj())
+      return ValueType::OBJ;
+    if (isNil())
+      return ValueType::NIL;
+    if (isEmpty())
+      return ValueType::EMPTY;
+    return ValueType::BOOL;
+  }
+  bool isNil() const { return m_bits == (kQnan | kTagNil); }
+  bool isBool() const { return (m_bits | 1) == (kQnan | kTagTrue); }
+  bool isNumber() const { return (m_bits & kQnan) != kQnan; }
+  bool isObj() const { return (m_bits & (kQnan | kSignBit)) == (kQnan | kSignBit); }
+  bool isEmpty() const { return m_bits == (kQnan | kTagEmpty); }
+
+  bool asBool() const { return m_bits == (kQnan | kTagTrue); }
+  double asNumber() const { return std::bit_cast<double>(m_bits); }
+  Obj *asObj() const {
+    return reinterpret_cast<Obj *>(
+        static_cast<uintptr_t>(m_bits & ~(kSignBit | kQnan)));
+  }
+
+  // Lox truthiness as implemented by the tree-walker: nil, false and 0 are
+  // falsey, everything else is truthy.
+  bool isFalsey() const {
+    if (isNumber())
+      return asNumber() == 0;
+    return m_bits == (kQnan | kTagNil) || m_bits == (kQnan | kTagFalse);
+  }
+
+private:
+  // The exponent, the quiet bit and one more mantissa bit, so that the NaNs
+  // arithmetic actually produces are never mistaken for a tagged value.
+  static constexpr uint64_t kQnan = 0x7ffc000000000000;
+  static constexpr uint64_t kSignBit = 0x8000000000000000;
+  static constexpr uint64_t kTagNil = 1;
+  static constexpr uint64_t kTagFalse = 2;
+  static constexpr uint64_t kTagTrue = 3;
+  static constexpr uint64_t kTagEmpty = 4;
+
+  static constexpr Value fromBits(uint64_t bits) {
+    Value value;
+    value.m_bits = bits;
+    return value;
+  }
+
+  uint64_t m_bits;
+};
+
+static_assert(sizeof(Value) == 8);
+
+// Equality as seen by `==`. Strings compare by content, since not every
+// string is interned (see LiteralStrings).
+bool valuesEqual(Value a, Value b);
+
+// Formats a number the same way `print` does.
+std::string formatNumber(double number);
+
+// The `print` representation of a value (strings are quoted).
+std::string valueToString(Value value);
+
+#endif // VALUE_H_
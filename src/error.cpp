@@ -6,28 +6,39 @@ namespace lox {
 bool hadError = false;
 bool hadRuntimeError = false;
 
+static thread_local bool *diverted = nullptr;
+
 void report(int line, const std::string &where, const std::string &message) {
+  if (diverted) {
+    *diverted = true;
+    return;
+  }
   std::cerr << "[line " << line << "] Error" << where << ": " << message
             << std::endl;
 }
 
 void error(int line, const std::string &message) {
   report(line, "", message);
-  hadError = true;
+  if (!diverted)
+    hadError = true;
 }
 
 void error(const Token &token, const std::string &message, bool isRuntime) {
   if (token.type == TokenType::END_OF_FILE) {
     report(token.line, " at end", message);
   } else {
-    report(token.line, " at '" + token.lexeme + "'", message);
+    report(token.line, " at '" + std::string(token.lexeme) + "'", message);
   }
+  if (diverted)
+    return;
   if (isRuntime) {
     hadRuntimeError = true;
   }
   hadError = true;
 }
 
+void divertErrors(bool *failed) { diverted = failed; }
+
 void resetError() {
   hadError = false;
   hadRuntimeError = false;
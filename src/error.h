@@ -21,4 +21,10 @@ void error(const Token& token, const std::string &message, bool isRuntime = fals
 
 // Error state management
 void resetError();
+
+// While set, errors reported on the calling thread are neither printed nor
+// recorded in hadError; they only set `*failed`. Pass nullptr to report
+// normally again. Lets ParallelParser parse on worker threads and fall back
+// if anything goes wrong.
+void divertErrors(bool *failed);
 } // namespace lox
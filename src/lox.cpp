@@ -1,12 +1,20 @@
+#include "ClosureCompiler.h"
 #include "Interpreter.h"
+#include "MappedFile.h"
+#include "Optimizer.h"
+#include "ParallelParser.h"
 #include "Parser.hpp"
+#include "ProgramCache.h"
 #include "Resolver.hpp"
 #include "Scanner.h"
+#include "VM.h"
 #include "error.h"
-#include <fstream>
+#include <charconv>
 #include <iostream>
-#include <sstream>
+#include <optional>
+#include <pthread.h>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using std::cout;
@@ -14,30 +22,141 @@ using std::endl;
 using std::string;
 using std::vector;
 
+// Which back end executes the resolved program
+enum class Engine {
+  TREE_WALKER, // Reference implementation: Interpreter
+  CLOSURE,     // Interpreter runtime, AST compiled to closures
+  VM,          // Compiler + bytecode VM
+};
+
+static Engine engine = Engine::TREE_WALKER;
+static bool optimize = false; // -O: run the Optimizer before executing
+static string cacheDirectory; // Where to cache resolved programs, if set
+static bool stream = false;   // --stream: run each declaration once parsed
+static unsigned parseThreads = 1;
+static HeapConfig heapConfig;
+
+// Native stack for running scripts. Each Lox call nests a few kilobytes of
+// C++ frames in the tree-walker and closure engines, so the default 8MB runs
+// out long before Interpreter::kCallsMax calls; this leaves room to reach
+// it. Pages are only committed as the recursion touches them.
+static constexpr size_t kNativeStackSize = size_t{256} << 20;
+
+// Parses the number after the '=' of a --name=value option, rejecting
+// anything that isn't entirely a non-negative number.
+static bool optionValue(const string &arg, double &value) {
+  const char *first = arg.data() + arg.find('=') + 1;
+  const char *last = arg.data() + arg.size();
+  auto [end, ec] = std::from_chars(first, last, value);
+  return ec == std::errc() && end == last && value >= 0;
+}
+
 void runFile(const string &);
 void runPrompt();
-void run(const string &);
+void run(std::string_view);
+void runIncrementally(std::string_view);
+void runOnLargeStack(void (*body)(void *), void *context);
 
 int main(int argc, char *argv[]) {
-  if (argc > 2) {
-    std::cout << "Usage: lox [script]" << std::endl;
+  const char *usage = "Usage: lox [-O] [--engine=tree|closure|vm] "
+                      "[--gc-threshold=bytes] [--gc-growth=factor] "
+                      "[--cache-dir=path] [--stream] [--parse-threads=n] "
+                      "[script]\n"
+                      "  --engine=vm runs the same programs as the other "
+                      "engines, up to 16M (2^24)\n"
+                      "  globals, constants per function, locals per "
+                      "function and captured variables\n"
+                      "  per closure, and jumps over at most 16MB of "
+                      "bytecode.";
+  vector<string> scripts;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "-O") {
+      optimize = true;
+    } else if (arg == "--engine=tree") {
+      engine = Engine::TREE_WALKER;
+    } else if (arg == "--engine=closure") {
+      engine = Engine::CLOSURE;
+    } else if (arg == "--engine=vm") {
+      engine = Engine::VM;
+    } else if (arg.starts_with("--gc-threshold=")) {
+      double bytes;
+      if (!optionValue(arg, bytes)) {
+        std::cout << usage << std::endl;
+        return 64;
+      }
+      heapConfig.minThreshold = static_cast<size_t>(bytes);
+    } else if (arg.starts_with("--gc-growth=")) {
+      if (!optionValue(arg, heapConfig.growthFactor) ||
+          heapConfig.growthFactor < 1) {
+        std::cout << usage << std::endl;
+        return 64;
+      }
+    } else if (arg.starts_with("--cache-dir=")) {
+      cacheDirectory = arg.substr(arg.find('=') + 1);
+    } else if (arg.starts_with("--parse-threads=")) {
+      double threads;
+      if (!optionValue(arg, threads) || threads < 1) {
+        std::cout << usage << std::endl;
+        return 64;
+      }
+      parseThreads = static_cast<unsigned>(threads);
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg.starts_with("-")) {
+      std::cout << usage << std::endl;
+      return 64;
+    } else {
+      scripts.push_back(arg);
+    }
+  }
+
+  if (scripts.size() > 1) {
+    std::cout << usage << std::endl;
     return 64;
-  } else if (argc == 2) {
-    runFile(argv[1]);
+  } else if (scripts.size() == 1) {
+    runOnLargeStack([](void *path) { runFile(*static_cast<string *>(path)); },
+                    &scripts[0]);
   } else {
-    runPrompt();
+    runOnLargeStack([](void *) { runPrompt(); }, nullptr);
   }
   return 0;
 }
 
+// Calls body(context) on a thread with a kNativeStackSize stack and waits
+// for it, falling back to the current thread if one can't be created.
+void runOnLargeStack(void (*body)(void *), void *context) {
+  struct Task {
+    void (*body)(void *);
+    void *context;
+  } task{body, context};
+  auto start = [](void *arg) -> void * {
+    auto *task = static_cast<Task *>(arg);
+    task->body(task->context);
+    return nullptr;
+  };
+
+  pthread_attr_t attr;
+  pthread_t thread;
+  bool started = false;
+  if (pthread_attr_init(&attr) == 0) {
+    started = pthread_attr_setstacksize(&attr, kNativeStackSize) == 0 &&
+              pthread_create(&thread, &attr, start, &task) == 0;
+    pthread_attr_destroy(&attr);
+  }
+  if (started) {
+    pthread_join(thread, nullptr);
+  } else {
+    body(context);
+  }
+}
+
 void runFile(const string &path) {
   cout << "processing file: " << path << endl;
-  std::ifstream ifile(path);
-  std::stringstream ss;
-  if (ifile.is_open()) {
-    ss << ifile.rdbuf();
-    run(ss.str());
-    ifile.close();
+  // Mapped rather than copied; everything run() builds points into it
+  MappedFile file;
+  if (file.open(path)) {
+    run(file.contents());
 
     // Indicate an error in the exit code
     if (lox::hadError)
@@ -65,21 +184,113 @@ void runPrompt() {
   }
 }
 
-void run(const string &source) {
-  Scanner scanner(source);
-  vector<Token> tokens = scanner.scanTokens();
-
-  Parser parser(tokens);
-  std::vector<Stmt *> statements = parser.parse();
-  // Stop if there was a syntax error
-  if (lox::hadError)
+void run(std::string_view source) {
+  if (stream) {
+    runIncrementally(source);
     return;
+  }
 
-  Interpreter interpreter;
-  Resolver resolver = Resolver(interpreter);
-  resolver.resolve(statements);
-  if (lox::hadError)
+  GlobalTable globals;
+  std::vector<Stmt *> statements;
+  // Whichever of these produced the program owns its nodes
+  std::optional<ProgramCache> cache;
+  std::optional<Parser> parser;
+  std::optional<ParallelParser> parallelParser;
+
+  if (!cacheDirectory.empty()) {
+    cache.emplace(cacheDirectory);
+  }
+  if (!cache || !cache->load(source, globals, statements)) {
+    if (parseThreads > 1) {
+      parallelParser.emplace(source, parseThreads);
+      statements = parallelParser->parse();
+    } else {
+      Scanner scanner(source);
+      parser.emplace(scanner);
+      statements = parser->parse();
+    }
+    // Stop if there was a syntax error
+    if (lox::hadError)
+      return;
+
+    Resolver resolver(globals);
+    resolver.resolve(statements);
+    if (lox::hadError)
+      return;
+
+    if (cache) {
+      cache->store(source, globals, statements);
+    }
+  }
+
+  Optimizer optimizer;
+  if (optimize) {
+    statements = optimizer.optimize(statements);
+  }
+
+  if (engine == Engine::VM) {
+    VM vm(heapConfig);
+    vm.interpret(statements);
     return;
+  }
+
+  Interpreter interpreter(globals, heapConfig);
+  if (engine == Engine::CLOSURE) {
+    ClosureCompiler compiler(interpreter);
+    compiler.interpret(statements);
+  } else {
+    interpreter.interpret(statements);
+  }
+}
 
-  interpreter.interpret(statements);
+// Runs each top-level declaration as soon as it has been parsed and
+// resolved, then frees its nodes unless functions or classes live on in
+// them. Output starts before the rest of the script has been read, so a
+// syntax error stops only what comes after it; parsing carries on to report
+// any others. There is no whole program here to cache.
+void runIncrementally(std::string_view source) {
+  GlobalTable globals;
+  Scanner scanner(source);
+  Parser parser(scanner);
+  Resolver resolver(globals);
+  Optimizer optimizer;
+
+  std::optional<VM> vm;
+  std::optional<Interpreter> interpreter;
+  std::optional<ClosureCompiler> compiler;
+  if (engine == Engine::VM) {
+    vm.emplace(heapConfig);
+  } else {
+    interpreter.emplace(globals, heapConfig);
+    if (engine == Engine::CLOSURE) {
+      compiler.emplace(*interpreter);
+    }
+  }
+
+  while (!parser.done()) {
+    Stmt *statement = parser.next();
+    if (lox::hadError)
+      continue;
+    resolver.resolve(statement);
+    if (lox::hadError)
+      continue;
+
+    std::vector<Stmt *> program{statement};
+    if (optimize) {
+      program = optimizer.optimize(program);
+    }
+    if (vm) {
+      vm->interpret(program);
+    } else if (compiler) {
+      compiler->interpret(program);
+    } else {
+      interpreter->interpret(program);
+    }
+    if (lox::hadRuntimeError)
+      return;
+    if (optimize) {
+      optimizer.releaseLast();
+    }
+    parser.releaseLast();
+  }
 }
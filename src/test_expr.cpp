@@ -6,12 +6,13 @@
 
 int main() {
   AstPrinter printer;
+  LiteralStrings strings;
 
   // Test all types of literals
   auto numLiteral = std::make_unique<LiteralExpr>(123.0);
-  auto strLiteral = std::make_unique<LiteralExpr>("hello");
+  auto strLiteral = std::make_unique<LiteralExpr>(strings.add("hello"));
   auto trueLiteral = std::make_unique<LiteralExpr>(true);
-  auto intLiteral = std::make_unique<LiteralExpr>(456);
+  auto intLiteral = std::make_unique<LiteralExpr>(456.0);
   auto nilLiteral = std::make_unique<LiteralExpr>(); // nil
 
   // Create expression: (* (- 123.45) (group true))
@@ -26,7 +27,7 @@ int main() {
   // Variable and assignment: (assign x 42)
   Token xToken(TokenType::IDENTIFIER, "x", 1);
   auto xVar = std::make_unique<VariableExpr>(xToken);
-  auto fortyTwo = std::make_unique<LiteralExpr>(42);
+  auto fortyTwo = std::make_unique<LiteralExpr>(42.0);
   auto assign = std::make_unique<AssignExpr>(xToken, *fortyTwo);
 
   std::cout << "Variable: " << printer.print(*xVar) << std::endl;